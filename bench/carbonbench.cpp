@@ -0,0 +1,538 @@
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include "carbonbench.h"
+#include "treegenerator.h"
+#include "outputparser.h"
+#include "sessionrunner.h"
+#include "session.h"
+#include "utils.h"
+#include "fixture.h"
+#include "config.h"
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QTemporaryDir>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QTextStream>
+#include <algorithm>
+#include <iostream>
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+// Count all heap allocations, so that the parser benchmarks can report them
+static std::atomic<unsigned long long> allocations(0);
+
+void * operator new(size_t size) {
+    allocations++;
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void * operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    free(p);
+}
+
+static const int constRepeats = 5;
+
+static double median(QList<qint64> values) {
+    if (values.isEmpty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    return values.count() % 2
+           ? values.at(values.count() / 2)
+           : (values.at(values.count() / 2 - 1) + values.at(values.count() / 2)) / 2.0;
+}
+
+static void log(const QString &str) {
+    std::cerr << str.toLocal8Bit().constData() << std::endl;
+}
+
+CarbonBench::CarbonBench(bool q, const QStringList &f)
+    : quick(q)
+    , filters(f)
+    , haveRunner(false)
+    , loop(0)
+    , firstOutputTime(-1)
+    , exitCode(0)
+    , signalCount(0)
+    , lastSessionProgress(-1) {
+    for (int i = 0; i < NUM_UPDATES; ++i) {
+        updates[i] = 0;
+    }
+}
+
+bool CarbonBench::run(const QString &workDir) {
+    dir = workDir;
+    haveRunner = QFile::exists(CARBON_BENCH_RUNNER) && !Utils::findExe("rsync").isEmpty();
+    if (!haveRunner) {
+        log(tr("rsync, or %1, not found - skipping benchmarks that run sessions").arg(CARBON_BENCH_RUNNER));
+    }
+
+    // Keep the runner's per-run logs, and ssh sockets, out of the user's cache
+    qputenv("XDG_CACHE_HOME", QFile::encodeName(dir + "/cache"));
+    QDir().mkpath(dir + "/sessions");
+
+    benchParser();
+    benchSessionLoading();
+    if (haveRunner) {
+        benchRunnerStart();
+        benchEndToEnd();
+        benchIncrementCleanup();
+    }
+    return true;
+}
+
+bool CarbonBench::save(const QString &fileName) const {
+    QJsonObject obj;
+    obj["version"] = QLatin1String(CARBON_VERSION);
+    obj["date"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    obj["quick"] = quick;
+    obj["results"] = results;
+
+    QByteArray json = QJsonDocument(obj).toJson();
+    if (fileName.isEmpty()) {
+        QTextStream(stdout) << json;
+        return true;
+    }
+
+    QFile f(fileName);
+    return f.open(QIODevice::WriteOnly) && f.write(json) == json.size();
+}
+
+void CarbonBench::runnerOutput() {
+    if (firstOutputTime < 0) {
+        firstOutputTime = timer.nsecsElapsed();
+    }
+}
+
+void CarbonBench::runnerFinished(int code) {
+    exitCode = code;
+    if (loop) {
+        loop->quit();
+    }
+}
+
+void CarbonBench::countSignal() {
+    signalCount++;
+}
+
+void CarbonBench::countStatus() {
+    updates[UPDATE_STATUS]++;
+}
+
+void CarbonBench::countChecking() {
+    updates[UPDATE_CHECKING]++;
+}
+
+void CarbonBench::countFileProgress() {
+    updates[UPDATE_FILE_PROGRESS]++;
+}
+
+void CarbonBench::countSessionProgress(int progress) {
+    updates[UPDATE_SESSION_PROGRESS]++;
+    lastSessionProgress = progress;
+}
+
+void CarbonBench::countItem() {
+    updates[UPDATE_ITEM]++;
+}
+
+bool CarbonBench::replay(const QString &fileName, bool realTime) {
+    QList<Fixture::Chunk> chunks;
+
+    if (!Fixture::load(fileName, chunks)) {
+        log(tr("Failed to load %1").arg(fileName));
+        return false;
+    }
+
+    OutputParser parser;
+    connect(&parser, SIGNAL(status(QString, bool)), this, SLOT(countStatus()));
+    connect(&parser, SIGNAL(checking(int)), this, SLOT(countChecking()));
+    connect(&parser, SIGNAL(fileProgress(int)), this, SLOT(countFileProgress()));
+    connect(&parser, SIGNAL(sessionProgress(int)), this, SLOT(countSessionProgress(int)));
+    connect(&parser, SIGNAL(item(QString, qint64, QString)), this, SLOT(countItem()));
+
+    int lines = 0;
+    qint64 bytes = 0;
+    qint64 parseTime = 0;
+    unsigned long long allocs = 0;
+    QElapsedTimer wallClock;
+    QElapsedTimer parseTimer;
+
+    wallClock.start();
+    foreach (const Fixture::Chunk &c, chunks) {
+        if (c.isError) {
+            continue; // stderr is only logged, not parsed
+        }
+        if (realTime) {
+            qint64 wait = c.msecs - wallClock.elapsed();
+            if (wait > 0) {
+                Utils::msleep(wait);
+            }
+        }
+        lines += c.data.count('\n') + c.data.count('\r');
+        bytes += c.data.size();
+
+        unsigned long long before = allocations;
+        parseTimer.start();
+        parser.parse(c.data);
+        parseTime += parseTimer.nsecsElapsed();
+        allocs += allocations - before;
+    }
+
+    double secs = parseTime / 1000000000.0;
+    addResult("replay.lines", lines, "lines");
+    addResult("replay.parseTime", parseTime / 1000000.0, "ms");
+    addResult("replay.wallClock", wallClock.nsecsElapsed() / 1000000.0, "ms");
+    addResult("replay.throughput", secs > 0 ? lines / secs : 0, "lines/s");
+    addResult("replay.bytes", secs > 0 ? (bytes / (1024.0 * 1024.0)) / secs : 0, "MiB/s");
+    addResult("replay.allocations", allocs, "allocations");
+    addResult("replay.allocationsPerLine", lines ? (double)allocs / lines : 0, "allocations");
+    addResult("replay.updates.status", updates[UPDATE_STATUS], "signals");
+    addResult("replay.updates.checking", updates[UPDATE_CHECKING], "signals");
+    addResult("replay.updates.fileProgress", updates[UPDATE_FILE_PROGRESS], "signals");
+    addResult("replay.updates.sessionProgress", updates[UPDATE_SESSION_PROGRESS], "signals");
+    addResult("replay.updates.item", updates[UPDATE_ITEM], "signals");
+    // For regression checks - a complete run should end at 1000
+    addResult("replay.final.sessionProgress", lastSessionProgress, "permille");
+    return true;
+}
+
+bool CarbonBench::enabled(const QString &name) const {
+    if (filters.isEmpty()) {
+        return true;
+    }
+    foreach (const QString &f, filters) {
+        if (name.startsWith(f)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CarbonBench::addResult(const QString &name, double value, const QString &unit) {
+    QJsonObject obj;
+    obj["name"] = name;
+    obj["value"] = value;
+    obj["unit"] = unit;
+    results.append(obj);
+    log(QString("%1: %2 %3").arg(name).arg(value, 0, 'f', 2).arg(unit));
+}
+
+Session * CarbonBench::createSession(const QString &name, const QString &src, const QString &dest, bool backup) {
+    Session *session = new Session(dir + "/sessions/" + name + CARBON_EXTENSION);
+    session->setSource(src + QLatin1Char('/'));
+    session->setDestination(dest + QLatin1Char('/'));
+    session->setMakeBackupsFlag(backup);
+    session->setMaxBackupDays(backup ? 1 : 0);
+    QDir().mkpath(dest);
+    return session;
+}
+
+// Returns the runner's exit code. If firstOutput is set, it is set to the time (ns) until the first output.
+int CarbonBench::runSession(Session *session, bool dryRun, qint64 *firstOutput) {
+    SessionRunner runner;
+    QEventLoop eventLoop;
+
+    runner.setRunner(QLatin1String(CARBON_BENCH_RUNNER));
+    connect(&runner, SIGNAL(finished(int)), this, SLOT(runnerFinished(int)));
+    connect(&runner, SIGNAL(output(QString)), this, SLOT(runnerOutput()));
+    loop = &eventLoop;
+    firstOutputTime = -1;
+    exitCode = -1;
+    runner.start(session, dryRun);
+    eventLoop.exec();
+    loop = 0;
+    if (firstOutput) {
+        *firstOutput = firstOutputTime;
+    }
+    return exitCode;
+}
+
+// Full, and then unchanged, synchronisation of each type of tree
+void CarbonBench::benchEndToEnd() {
+    static const char * constKinds[] = { "small", "huge", "deep", 0 };
+
+    for (int k = 0; constKinds[k]; ++k) {
+        QString kind = QLatin1String(constKinds[k]);
+        QString name = QLatin1String("e2e.") + kind;
+
+        if (!enabled(name)) {
+            continue;
+        }
+
+        TreeGenerator gen;
+        QString src = dir + "/src-" + kind;
+        bool ok = QLatin1String("small") == kind
+                  ? gen.smallFiles(src, quick ? 2000 : 20000)
+                  : QLatin1String("huge") == kind
+                    ? gen.hugeFiles(src, 4, (quick ? 16 : 256) * 1024 * 1024)
+                    : gen.deepTree(src, quick ? 30 : 100, 10);
+
+        if (!ok) {
+            log(tr("Failed to create %1 tree").arg(kind));
+            continue;
+        }
+
+        Session *session = createSession("e2e-" + kind, src, dir + "/dest-" + kind, false);
+
+        timer.start();
+        int rv = runSession(session, false);
+        qint64 initial = timer.nsecsElapsed();
+        timer.start();
+        rv = 0 == rv ? runSession(session, false) : rv;
+        qint64 unchanged = timer.nsecsElapsed();
+
+        if (0 == rv) {
+            addResult(name + ".initial", initial / 1000000.0, "ms");
+            addResult(name + ".unchanged", unchanged / 1000000.0, "ms");
+            addResult(name + ".throughput", (gen.bytesWritten() / (1024.0 * 1024.0)) / (initial / 1000000000.0), "MiB/s");
+        } else {
+            log(tr("%1 failed: %2").arg(name).arg(SessionRunner::errorString(rv)));
+        }
+        delete session;
+    }
+}
+
+// Time until the runner produces its first output, and completes, for a dry run of an empty folder
+void CarbonBench::benchRunnerStart() {
+    if (!enabled("runner.start")) {
+        return;
+    }
+
+    Session *session = createSession("runner-start", dir + "/empty", dir + "/empty-dest", false);
+    QList<qint64> first;
+    QList<qint64> total;
+
+    QDir().mkpath(dir + "/empty");
+    for (int i = 0; i < constRepeats; ++i) {
+        qint64 firstOutput;
+        timer.start();
+        if (0 != runSession(session, true, &firstOutput)) {
+            log(tr("runner.start failed"));
+            delete session;
+            return;
+        }
+        total.append(timer.nsecsElapsed());
+        first.append(firstOutput);
+    }
+    addResult("runner.start.firstOutput", median(first) / 1000000.0, "ms");
+    addResult("runner.start.total", median(total) / 1000000.0, "ms");
+    delete session;
+}
+
+// Throughput of OutputParser, on output as produced by 'rsync -v --progress'
+void CarbonBench::benchParser() {
+    if (!enabled("parser")) {
+        return;
+    }
+
+    int numFiles = quick ? 20000 : 200000;
+    QByteArray data;
+    int lines = 0;
+
+    for (int i = 0; i < numFiles; ++i) {
+        data += QString(CARBON_PREFIX "d%1/file%2.txt\n").arg(i / 100).arg(i).toLatin1();
+        for (int p = 25; p < 100; p += 25) {
+            data += QString("\r    %1  %2%    1.23MB/s    0:00:00").arg(p * 1310).arg(p).toLatin1();
+        }
+        data += QString("\r    131,072 100%   12.34MB/s    0:00:00 (xfr#%1, to-chk=%2/%3)\n").arg(i + 1).arg(numFiles - i - 1).arg(numFiles).toLatin1();
+        lines += 5;
+    }
+
+    OutputParser parser;
+    connect(&parser, SIGNAL(status(QString, bool)), this, SLOT(countSignal()));
+    connect(&parser, SIGNAL(fileProgress(int)), this, SLOT(countSignal()));
+    connect(&parser, SIGNAL(sessionProgress(int)), this, SLOT(countSignal()));
+    signalCount = 0;
+
+    // Feed in chunks, as QProcess would
+    static const int constChunk = 4096;
+    unsigned long long before = allocations;
+    timer.start();
+    for (int pos = 0; pos < data.size(); pos += constChunk) {
+        parser.parse(data.mid(pos, constChunk));
+    }
+    double secs = timer.nsecsElapsed() / 1000000000.0;
+    unsigned long long allocs = allocations - before;
+
+    addResult("parser.lines", lines / secs, "lines/s");
+    addResult("parser.bytes", (data.size() / (1024.0 * 1024.0)) / secs, "MiB/s");
+    addResult("parser.signals", signalCount, "signals");
+    addResult("parser.allocationsPerLine", (double)allocs / lines, "allocations");
+}
+
+// Loading of many session files, as done by SessionWidget at startup
+void CarbonBench::benchSessionLoading() {
+    if (!enabled("sessions.load")) {
+        return;
+    }
+
+    int count = quick ? 500 : 5000;
+    QString sessionDir = dir + "/many-sessions/";
+    Session *session = new Session(sessionDir + "template" CARBON_EXTENSION);
+
+    QDir().mkpath(sessionDir);
+    session->setSource("/home/user/Documents/");
+    session->setDestination("/media/backup/Documents/");
+    session->save();
+    delete session;
+
+    QString templateFile = sessionDir + "template" CARBON_EXTENSION;
+    for (int i = 0; i < count; ++i) {
+        QFile::copy(templateFile, sessionDir + QString("session%1" CARBON_EXTENSION).arg(i));
+    }
+
+    timer.start();
+    QFileInfoList files = QDir(sessionDir).entryInfoList(QStringList() << "*" CARBON_EXTENSION, QDir::NoDotAndDotDot | QDir::Files);
+    QList<Session *> sessions;
+    foreach (const QFileInfo &f, files) {
+        sessions.append(new Session(f.absoluteFilePath()));
+    }
+    qint64 elapsed = timer.nsecsElapsed();
+    qDeleteAll(sessions);
+
+    addResult("sessions.load.total", elapsed / 1000000.0, "ms");
+    addResult("sessions.load.perSession", (elapsed / 1000.0) / files.count(), "us");
+}
+
+// A backup, where all previous increments (hard linked to each other) have expired
+void CarbonBench::benchIncrementCleanup() {
+    if (!enabled("increments.cleanup")) {
+        return;
+    }
+
+    TreeGenerator gen;
+    int numIncrements = quick ? 10 : 50;
+    QString dest = dir + "/increments";
+    QString src = dir + "/increments-src";
+    QString newest = gen.increments(dest, numIncrements, quick ? 200 : 2000, 7);
+
+    if (newest.isEmpty() || !gen.smallFiles(src, 10)) {
+        log(tr("Failed to create increments"));
+        return;
+    }
+
+    Session *session = createSession("increments", src, dest, true);
+    QFile info(session->infoFileName());
+    if (info.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        QTextStream(&info) << "BackupTime=" << newest << endl;
+        info.close();
+    }
+
+    timer.start();
+    int rv = runSession(session, false);
+    qint64 elapsed = timer.nsecsElapsed();
+
+    if (0 == rv) {
+        int remaining = QDir(dest).entryList(QDir::Dirs | QDir::NoDotAndDotDot).count();
+        addResult("increments.cleanup.total", elapsed / 1000000.0, "ms");
+        addResult("increments.cleanup.erased", numIncrements + 1 - remaining, "increments");
+    } else {
+        log(tr("increments.cleanup failed: %1").arg(SessionRunner::errorString(rv)));
+    }
+    delete session;
+}
+
+static void usage() {
+    log("Usage: carbon-bench [-q|--quick] [-k|--keep] [-o <results.json>] [<benchmark prefix>...]\n"
+        "       carbon-bench --replay <fixture> [--realtime] [-o <results.json>]\n"
+        "\n"
+        "  -q, --quick  Use smaller data sets.\n"
+        "  -k, --keep   Do not remove the generated data.\n"
+        "  -o <file>    Write JSON results to file, instead of stdout.\n"
+        "  --replay     Feed a fixture, as recorded by 'carbon --run --record DIR', to the parser\n"
+        "               and report its throughput, allocations, and the updates it would make.\n"
+        "  --realtime   Replay with the fixture's original timing, rather than at full speed.\n"
+        "\n"
+        "Benchmarks: parser, sessions.load, runner.start, e2e.small, e2e.huge, e2e.deep, increments.cleanup");
+}
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("carbon-bench");
+
+    QStringList args = app.arguments();
+    QStringList filters;
+    QString output;
+    bool quick = false;
+    bool keep = false;
+    bool realTime = false;
+    QString replayFile;
+
+    for (int i = 1; i < args.count(); ++i) {
+        const QString &a = args.at(i);
+        if (QLatin1String("-q") == a || QLatin1String("--quick") == a) {
+            quick = true;
+        } else if (QLatin1String("-k") == a || QLatin1String("--keep") == a) {
+            keep = true;
+        } else if (QLatin1String("-o") == a && i + 1 < args.count()) {
+            output = args.at(++i);
+        } else if (QLatin1String("--replay") == a && i + 1 < args.count()) {
+            replayFile = args.at(++i);
+        } else if (QLatin1String("--realtime") == a) {
+            realTime = true;
+        } else if (a.startsWith(QLatin1Char('-'))) {
+            usage();
+            return 1;
+        } else {
+            filters.append(a);
+        }
+    }
+
+    if (!replayFile.isEmpty()) {
+        CarbonBench bench(false, QStringList());
+        return bench.replay(replayFile, realTime) && bench.save(output) ? 0 : 1;
+    }
+
+    QTemporaryDir tempDir(QDir::tempPath() + "/carbon-bench-XXXXXX");
+    if (!tempDir.isValid()) {
+        log("Failed to create temporary folder");
+        return 1;
+    }
+    tempDir.setAutoRemove(!keep);
+    if (keep) {
+        log(QString("Data is in %1").arg(tempDir.path()));
+    }
+
+    CarbonBench bench(quick, filters);
+    bench.run(tempDir.path());
+    return bench.save(output) ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+#ifndef __CARBON_BENCH_H__
+#define __CARBON_BENCH_H__
+
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QJsonArray>
+#include <QElapsedTimer>
+
+class Session;
+class QEventLoop;
+
+class CarbonBench : public QObject {
+    Q_OBJECT
+
+public:
+    enum Updates {
+        UPDATE_STATUS,
+        UPDATE_CHECKING,
+        UPDATE_FILE_PROGRESS,
+        UPDATE_SESSION_PROGRESS,
+        UPDATE_ITEM,
+
+        NUM_UPDATES
+    };
+
+    CarbonBench(bool q, const QStringList &f);
+    virtual ~CarbonBench() { }
+
+    bool run(const QString &workDir);
+    // Feed a recorded fixture to OutputParser, at full speed or with its original timing
+    bool replay(const QString &fileName, bool realTime);
+    bool save(const QString &fileName) const;
+
+private Q_SLOTS:
+    void runnerOutput();
+    void runnerFinished(int exitCode);
+    void countSignal();
+    void countStatus();
+    void countChecking();
+    void countFileProgress();
+    void countSessionProgress(int progress);
+    void countItem();
+
+private:
+    bool enabled(const QString &name) const;
+    void addResult(const QString &name, double value, const QString &unit);
+    Session * createSession(const QString &name, const QString &src, const QString &dest, bool backup);
+    int runSession(Session *session, bool dryRun, qint64 *firstOutput = 0);
+
+    void benchEndToEnd();
+    void benchRunnerStart();
+    void benchParser();
+    void benchSessionLoading();
+    void benchIncrementCleanup();
+
+private:
+    bool quick;
+    QStringList filters;
+    QString dir;
+    bool haveRunner;
+    QJsonArray results;
+    QEventLoop *loop;
+    QElapsedTimer timer;
+    qint64 firstOutputTime;
+    int exitCode;
+    int signalCount;
+    int updates[NUM_UPDATES];
+    int lastSessionProgress;
+};
+
+#endif
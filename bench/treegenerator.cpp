@@ -0,0 +1,142 @@
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include "treegenerator.h"
+#include <QDir>
+#include <QFile>
+#include <QDateTime>
+#include <unistd.h>
+#include <utime.h>
+#include <stdlib.h>
+
+static const int constBlockSize = 1024 * 1024;
+
+TreeGenerator::TreeGenerator()
+    : written(0)
+    , files(0) {
+    // Random data, so that rsync's compression, and delta matching, have something realistic to work with
+    block.resize(constBlockSize);
+    srandom(1);
+    for (int i = 0; i < constBlockSize; ++i) {
+        block[i] = (char)(random() & 0xFF);
+    }
+}
+
+bool TreeGenerator::smallFiles(const QString &dir, int count) {
+    for (int i = 0; i < count; ++i) {
+        QString sub = dir + QString("/d%1").arg(i / 100, 4, 10, QChar('0'));
+        if (0 == i % 100 && !QDir().mkpath(sub)) {
+            return false;
+        }
+        if (!writeFile(sub + QString("/f%1.txt").arg(i), 1024 + (random() % (7 * 1024)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TreeGenerator::hugeFiles(const QString &dir, int count, qint64 size) {
+    if (!QDir().mkpath(dir)) {
+        return false;
+    }
+    for (int i = 0; i < count; ++i) {
+        if (!writeFile(dir + QString("/image%1.img").arg(i), size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TreeGenerator::deepTree(const QString &dir, int depth, int filesPerLevel) {
+    QString level = dir;
+    for (int d = 0; d < depth; ++d) {
+        level += QString("/level%1").arg(d);
+        if (!QDir().mkpath(level)) {
+            return false;
+        }
+        for (int f = 0; f < filesPerLevel; ++f) {
+            if (!writeFile(level + QString("/f%1").arg(f), 512 + (random() % 4096))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+QString TreeGenerator::increments(const QString &dir, int numIncrements, int filesPerIncrement, int ageDays) {
+    QDateTime when = QDateTime::currentDateTime().addDays(-(ageDays + numIncrements));
+    QString first;
+    QString name;
+
+    for (int i = 0; i < numIncrements; ++i, when = when.addDays(1)) {
+        name = when.toString("yyyy-MM-dd hh:mm:ss");
+        QString incr = dir + QLatin1Char('/') + name;
+
+        if (0 == i) {
+            first = incr;
+            if (!smallFiles(incr, filesPerIncrement)) {
+                return QString();
+            }
+        } else {
+            for (int f = 0; f < filesPerIncrement; ++f) {
+                QString sub = QString("/d%1").arg(f / 100, 4, 10, QChar('0'));
+                QString file = sub + QString("/f%1.txt").arg(f);
+                if ((0 == f % 100 && !QDir().mkpath(incr + sub)) ||
+                    0 != ::link(QFile::encodeName(first + file).constData(), QFile::encodeName(incr + file).constData())) {
+                    return QString();
+                }
+            }
+        }
+    }
+
+    // Age the increment folders, as the runner uses their modification time to decide what to erase
+    when = QDateTime::currentDateTime().addDays(-(ageDays + numIncrements));
+    foreach (const QString &incr, QDir(dir).entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name)) {
+        struct utimbuf times;
+        times.actime = times.modtime = when.toTime_t();
+        ::utime(QFile::encodeName(dir + QLatin1Char('/') + incr).constData(), &times);
+        when = when.addDays(1);
+    }
+    return name;
+}
+
+bool TreeGenerator::writeFile(const QString &name, qint64 size) {
+    QFile f(name);
+
+    if (!f.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    for (qint64 left = size; left > 0; ) {
+        qint64 chunk = qMin(left, (qint64)constBlockSize);
+        // Vary the start of each block, so that files do not all have the same content
+        block[0] = (char)(random() & 0xFF);
+        block[1] = (char)(files & 0xFF);
+        if (f.write(block.constData(), chunk) != chunk) {
+            return false;
+        }
+        left -= chunk;
+    }
+    written += size;
+    files++;
+    return true;
+}
@@ -0,0 +1,60 @@
+#ifndef __TREE_GENERATOR_H__
+#define __TREE_GENERATOR_H__
+
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include <QString>
+#include <QByteArray>
+
+// Creates synthetic source trees, and backup destinations, for carbon-bench
+class TreeGenerator {
+public:
+    TreeGenerator();
+
+    // Many small files, spread over folders of 100 files each
+    bool smallFiles(const QString &dir, int count);
+    // A few large files
+    bool hugeFiles(const QString &dir, int count, qint64 size);
+    // A single chain of depth folders, with filesPerLevel files in each
+    bool deepTree(const QString &dir, int depth, int filesPerLevel);
+    // A backup destination with numIncrements increments, older than ageDays, whose files are all hard links
+    // to those of the first increment. Returns the name of the newest increment, or an empty string on error.
+    QString increments(const QString &dir, int numIncrements, int filesPerIncrement, int ageDays);
+
+    qint64 bytesWritten() const {
+        return written;
+    }
+    int filesWritten() const {
+        return files;
+    }
+
+private:
+    bool writeFile(const QString &name, qint64 size);
+
+private:
+    QByteArray block;
+    qint64 written;
+    int files;
+};
+
+#endif
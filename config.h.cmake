@@ -28,12 +28,20 @@
 #define CARBON_INFO_EXTENSION "@CARBON_INFO_EXTENSION@"
 #define CARBON_LOCK_EXTENSION "@CARBON_LOCK_EXTENSION@"
 #define CARBON_EXCLUDE_EXTENSION "@CARBON_EXCLUDE_EXTENSION@"
+#define CARBON_HISTORY_EXTENSION "@CARBON_HISTORY_EXTENSION@"
+#define CARBON_STATE_EXTENSION "@CARBON_STATE_EXTENSION@"
+#define CARBON_CHANGES_EXTENSION "@CARBON_CHANGES_EXTENSION@"
+#define CARBON_CHECKPOINT_EXTENSION "@CARBON_CHECKPOINT_EXTENSION@"
+#define CARBON_COMMAND_LOG_EXTENSION "@CARBON_COMMAND_LOG_EXTENSION@"
+#define CARBON_WATCH_EXTENSION "@CARBON_WATCH_EXTENSION@"
 #define CARBON_PREFIX "@CARBON_PREFIX@"
 #define CARBON_MSG_PREFIX "@CARBON_MSG_PREFIX@"
 #define CARBON_ERROR_PREFIX "@CARBON_ERROR_PREFIX@"
+#define CARBON_SHARD_PREFIX "@CARBON_SHARD_PREFIX@"
+#define CARBON_ITEM_PREFIX "@CARBON_ITEM_PREFIX@"
+#define CARBON_PHASE_PREFIX "@CARBON_PHASE_PREFIX@"
 #define CARBON_GUI_PARENT "@CARBON_GUI_PARENT@"
 #define CARBON_RUNNER "@CMAKE_INSTALL_PREFIX@/share/@CMAKE_PROJECT_NAME@/scripts/@CMAKE_PROJECT_NAME@-runner"
-#define CARBON_TERMINATE "@CMAKE_INSTALL_PREFIX@/share/@CMAKE_PROJECT_NAME@/scripts/@CMAKE_PROJECT_NAME@-terminate"
 #define INSTALL_PREFIX "@CMAKE_INSTALL_PREFIX@"  /* No CARBON_ prefix to this name, as its used in 'support' */
 #define CARBON_SYSTEM_DEF_FILE "@CMAKE_INSTALL_PREFIX@/share/@CMAKE_PROJECT_NAME@/default@CARBON_EXTENSION@"
 #define CARBON_PACKAGE_NAME "@PROJECT_NAME@"
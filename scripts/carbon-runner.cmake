@@ -2,6 +2,16 @@
 
 appName=`basename $0`
 
+# Milliseconds since boot - monotonic, unlike date
+function uptime_ms()
+{
+    local up rest
+    read up rest < /proc/uptime
+    echo $(( 10#${up/./} * 10 ))
+}
+
+runnerStartMs=`uptime_ms`
+
 function show_help()
 {
     exName=Wibble
@@ -10,9 +20,21 @@ function show_help()
     echo
     echo "(C) Craig Drummond 2013 - Released under the GPL (v3 or later)"
     echo
-    echo "Usage: $appName [-d] <session/filename>"
+    echo "Usage: $appName [-d] [-f <change set>] <session/filename>"
+    echo "       $appName -V [-a <days>] [-i <increment>] <session/filename>"
+    echo "       $appName -b <sample file>"
     echo "       -d  Perform a dry-run (i.e. show what would happen, but don't"
     echo "           do any actual synchronisation)"
+    echo "       -f  Only synchronise the files listed in the change set saved by"
+    echo "           a previous dry-run, instead of scanning the whole source. Not"
+    echo "           used for backups."
+    echo "       -V  Verify the session's backup increments (or just the one"
+    echo "           given by -i) against the file hashes catalogued when they"
+    echo "           were made. With -a, files verified within that many days"
+    echo "           are only checked for changes, and not read again."
+    echo "       -b  Benchmark the large file profiles against a sample file (e.g."
+    echo "           a VM image), and report which is quickest. Requires free space"
+    echo "           for two copies of the sample, alongside it."
     echo
     echo "e.g. $appName $exName"
     echo "         - This will synchronise the $exName session (as created in"
@@ -26,9 +48,11 @@ function show_help()
     exit 101
 }
 
-shortOpts="dh"
-longOpts="dryrun,help"
+shortOpts="dhb:f:Va:i:"
+longOpts="dryrun,help,benchmark:,files-from:,verify,max-age:,increment:"
 progName=carbon-runner
+# The runner re-runs itself to log its output, and that run needs the same options
+runnerArgs=("$@")
 args=$(getopt -s bash --options $shortOpts  --longoptions $longOpts --name $progName -- "$@" )
 
 eval set -- "$args"
@@ -42,6 +66,26 @@ while true; do
          shift
          doDryRun=true
          ;;
+      -b|--benchmark)
+         benchmarkFile="$2"
+         shift 2
+         ;;
+      -f|--files-from)
+         changesFile="$2"
+         shift 2
+         ;;
+      -V|--verify)
+         shift
+         verifyMode=true
+         ;;
+      -a|--max-age)
+         verifyAge="$2"
+         shift 2
+         ;;
+      -i|--increment)
+         verifyIncrement="$2"
+         shift 2
+         ;;
       *)
          shift
          break
@@ -83,6 +127,7 @@ function log_error()
 }
 
 projectName=`echo @CMAKE_PROJECT_NAME@ | tr "[:upper:]" "[:lower:]"`
+cacheDir="${XDG_CACHE_HOME:-$HOME/.cache}/$projectName"
 
 function notify()
 {
@@ -100,13 +145,932 @@ function notify()
     fi
 }
 
+# Mark the start of a phase of the run - each phase lasts until the next one starts. The GUI splits the 'scan'
+# phase into scanning and transferring, when rsync starts reporting files.
+function phase()
+{
+    if [ "$@CARBON_GUI_PARENT@" = "true" ] && [ "$CARBON_NO_MSG_PREFIX" != "true" ] ; then
+        echo "@CARBON_PHASE_PREFIX@$1 ${2:-`uptime_ms`}"
+    fi
+}
+
+# Export the variables that describe the run to the session's commands. $1 is the exit code, for post-sync commands.
+function export_hook_env()
+{
+    export CARBON_SESSION="$sessionName" CARBON_SOURCE="$src" CARBON_DESTINATION="$dest" CARBON_BACKUP="${makeBackups:-false}"
+    if [ "$makeBackups" = "true" ] && [ "$destFolder" != "" ] ; then
+        export CARBON_INCREMENT="$destFolder"
+    fi
+    if [ "$1" != "" ] ; then
+        export CARBON_EXIT_CODE=$1
+        export CARBON_DURATION_MS=$(( `uptime_ms` - runnerStartMs ))
+        export CARBON_TRANSFERRED_BYTES=`transferred_bytes`
+        export CARBON_CHANGED_FILES=`changed_files`
+    fi
+}
+
+# Command prefix that kills commands after commandTimeout seconds (then SIGKILL 10s later), if set. timeout runs the
+# command in its own process group, so that the command's children are killed too.
+function hook_timeout()
+{
+    if [ "$commandTimeout" != "" ] && [ "$commandTimeout" -gt 0 ] 2>/dev/null ; then
+        echo "timeout --kill-after=10 $commandTimeout"
+    fi
+}
+
+# Run one of the session's shell commands, logging its output. $3 is the exit code, for post-sync commands. Returns
+# the command's exit code - 124 if it timed out. The command runs in the background, so that the cancel trap can
+# signal it whilst it is waited upon.
+function run_hook()
+{
+    local rv
+    local readerPid
+    local out
+
+    log_msg "Running $1 command"
+    exec {out}> >(while IFS= read -r line ; do log_msg "$line" ; done)
+    readerPid=$!
+    ( export_hook_env $3 ; exec `hook_timeout` bash -c "$2" ) < /dev/null >&$out 2>&1 &
+    hookPid=$!
+    wait $hookPid
+    rv=$?
+    hookPid=""
+    exec {out}>&-
+    wait $readerPid 2>/dev/null
+    if [ $rv -eq 124 ] && [ "`hook_timeout`" != "" ] ; then
+        log_error "The $1 command timed out after ${commandTimeout}s"
+    fi
+    return $rv
+}
+
+# Run the success command detached from the runner, appending its output to the session's command log. This lets the
+# runner exit, and so release the session, whilst a slow command (e.g. uploading a snapshot) runs on.
+function run_background_hook()
+{
+    local hookLog="$fileName@CARBON_COMMAND_LOG_EXTENSION@"
+
+    log_msg "Running $1 command in the background, logging to $hookLog"
+    ( export_hook_env $3
+      echo "`date '+%F %T'` $1 command started"
+      setsid --wait `hook_timeout` bash -c "$2"
+      rv=$?
+      echo "`date '+%F %T'` $1 command finished ($rv)" ) < /dev/null >> "$hookLog" 2>&1 &
+    disown
+}
+
+# Run the success, or failure, command - at most once per run.
+function run_post_hooks()
+{
+    if [ "$hooksEnabled" = "true" ] ; then
+        hooksEnabled=false
+        if [ $1 -eq 0 ] && [ "$successCommand" != "" ] && [ "$successCommandBackground" = "true" ] ; then
+            run_background_hook success "$successCommand" $1
+        elif [ $1 -eq 0 ] && [ "$successCommand" != "" ] ; then
+            run_hook success "$successCommand" $1
+        elif [ $1 -ne 0 ] && [ "$failureCommand" != "" ] ; then
+            run_hook failure "$failureCommand" $1
+        fi
+        if [ $? -ne 0 ] ; then
+            log_error "Post-sync command failed"
+        fi
+    fi
+}
+
 function log_error_and_exit()
 {
     notify $1 "error" "$2"
     log_error "$2"
+    run_post_hooks $1
+    write_metrics $1
+    record_run $1
+    if [ "$lockTaken" = "true" ] ; then
+        rm -f "$fileName@CARBON_LOCK_EXTENSION@"
+    fi
+    phase end
     exit $1
 }
 
+# SIGTERM/SIGINT handler. The GUI cancels a run by signalling the runner's process group, so rsync (and ssh, and any
+# parallel shards) will have been signalled too. Exits with rsync's code for being signalled.
+function cancelled()
+{
+    trap - TERM INT
+    log_error "Cancelled"
+    if [ "$hookPid" != "" ] ; then
+        # Commands run with a timeout are in their own process group - timeout passes the signal on
+        kill -TERM $hookPid 2>/dev/null
+    fi
+    if [ "$shardDir" != "" ] ; then
+        rm -rf "$shardDir"
+    fi
+    rm -f "$fileName@CARBON_LOCK_EXTENSION@"
+    write_metrics 20
+    record_run 20
+    phase end
+    exit 20
+}
+
+# Quote a string so that it survives being passed through the remote shell
+function shell_quote()
+{
+    local q="'\\''"
+    printf "'%s'" "${1//\'/$q}"
+}
+
+# Remote locations are user@host:path - rsync daemon URLs (host::module, rsync://) are not reachable via ssh
+function is_ssh_location()
+{
+    if [[ "$1" == rsync://* ]] || [[ "$1" == *::* ]] ; then
+        return 1
+    fi
+    return 0
+}
+
+function remote_host()
+{
+    echo "${1%%:*}"
+}
+
+function remote_path()
+{
+    echo "${1#*:}"
+}
+
+# All ssh traffic (rsync itself, and any remote commands) is multiplexed over a single master connection per
+# user@host. The master's socket lives in the cache folder, and it persists for sshPersist after its last use - so
+# back-to-back, or concurrent, sessions to the same host skip the handshake and authentication entirely.
+sshControlPath=""
+sshMasterHost=""
+sshPersist=${CARBON_SSH_PERSIST:-10m}
+sshCipherOpts=""
+
+function ssh_start_master()
+{
+    if [ "$sshMasterHost" = "$1" ] ; then
+        return 0
+    fi
+
+    local controlDir="$cacheDir/ssh"
+    mkdir -p "$controlDir" && chmod 700 "$controlDir"
+    sshControlPath="$controlDir/%C"
+    # A master keeps the ciphers it was opened with, so runs that prefer particular ciphers have their own master
+    if [ "$sshCipherOpts" != "" ] ; then
+        sshControlPath="$controlDir/%C-cipher"
+    fi
+
+    if ssh -o ControlPath="$sshControlPath" -O check "$1" > /dev/null 2>&1 ||
+       ssh -o ControlMaster=auto -o ControlPath="$sshControlPath" -o ControlPersist=$sshPersist $sshCipherOpts -fN "$1" ; then
+        sshMasterHost="$1"
+        return 0
+    fi
+    sshControlPath=""
+    return 1
+}
+
+# Remote shell for rsync. ControlMaster=auto, so that if the master has gone away rsync's connection takes over.
+function ssh_command()
+{
+    echo "ssh -S \"$sshControlPath\" -o ControlMaster=auto -o ControlPersist=$sshPersist $sshCipherOpts"
+}
+
+function remote_exec()
+{
+    local host="$1"
+    shift
+    ssh -o ControlPath="$sshControlPath" -o ControlMaster=no "$host" "$@"
+}
+
+# Prune, and list, remote increments. Everything is performed by a single remote shell invocation - so removing any
+# number of old increments costs one round-trip over the master connection.
+remotePruneScript='
+dir="$1"
+maxAgeMins="$2"
+current="$3"
+cd "$dir" 2>/dev/null || exit 0
+[ -d "$current" ] || exit 0
+touch "$current"
+pattern="[0-9][0-9][0-9][0-9]-[0-9][0-9]-[0-9][0-9] [0-9][0-9]:[0-9][0-9]:[0-9][0-9]"
+find . -mindepth 1 -maxdepth 1 -type d -name "$pattern" ! -name "$current" -mmin +"$maxAgeMins" -printf "E %f\n" -exec rm -rf {} +
+find . -mindepth 1 -maxdepth 1 -type d -name "$pattern" -printf "K %f\n"
+'
+
+function prune_remote_increments()
+{
+    if ! is_ssh_location "$dest" ; then
+        log_msg "Not cleaning old backups, as destination is not reachable via ssh"
+        return
+    fi
+
+    local host=`remote_host "$dest"`
+    local path=`remote_path "$dest"`
+
+    if [ "$path" = "/" ] || [ "$path" = "" ] ; then
+        return
+    fi
+
+    if ! ssh_start_master "$host" ; then
+        log_error "Failed to connect to $host to clean old backups"
+        return
+    fi
+
+    log_msg "Cleaning old backups"
+    local kept=0
+    local line
+    while IFS= read -r line ; do
+        case "$line" in
+            E\ *) log_msg "Erasing $dest${line:2}" ;;
+            K\ *) let kept="$kept + 1" ;;
+        esac
+    done < <(remote_exec "$host" "sh -c `shell_quote "$remotePruneScript"` carbon `shell_quote "$path"` $1 `shell_quote "$currentBackupTime"`")
+    log_msg "$kept increment(s) on $host"
+    remoteIncrements=$kept
+}
+
+# Suffixes of files that are already compressed, and so are not worth compressing again (--skip-compress)
+skipCompressList="3g2/3gp/7z/aac/ace/apk/avi/bz2/cab/deb/dmg/docx/ear/epub/f4v/flac/flv/gpg/gz/heic/iso/jar/jpeg/jpg/\
+lrz/lz/lz4/lzma/lzo/m2ts/m4a/m4b/m4p/m4v/mka/mkv/mov/mp3/mp4/mpeg/mpg/mts/odg/odp/ods/odt/oga/ogg/ogv/opus/\
+png/pptx/qt/rar/rpm/rz/squashfs/tbz/tbz2/tgz/tlz/ts/txz/vob/war/webm/webp/whl/xlsx/xz/z/zip/zst"
+
+# Compression used for the current run, as chosen by select_compression
+compressChoice=none
+compressLevel=0
+probeRate=0
+
+# Measure throughput (KiB/s) of incompressible data over the shared ssh connection. A small probe is sent first, and
+# only if that completes quickly is a larger one used - so slow links are not held up for long.
+function probe_link()
+{
+    local size start end elapsed
+    for size in 256 8192 ; do
+        start=`date +%s%N`
+        head -c ${size}K /dev/urandom | remote_exec "$remoteHost" "cat > /dev/null" || return 1
+        end=`date +%s%N`
+        let elapsed="($end - $start) / 1000000"
+        if [ $elapsed -lt 1 ] ; then
+            elapsed=1
+        fi
+        let probeRate="$size * 1000 / $elapsed"
+        if [ $elapsed -gt 250 ] ; then
+            break
+        fi
+    done
+    return 0
+}
+
+function rsync_has_compressor()
+{
+    rsync --version 2>/dev/null | grep -A1 "Compress list" | tail -n 1 | grep -qw "$1"
+}
+
+# Pick compression algorithm and level for "auto" mode. Fast links (>= ~1GbE) are CPU-bound when compressing, so
+# compression is disabled; progressively slower links get progressively stronger compression.
+function select_compression()
+{
+    compressChoice=none
+    compressLevel=0
+
+    if [ "$sshCommand" = "" ] || [ "$doDryRun" = "true" ] ; then
+        return
+    fi
+
+    if ! probe_link ; then
+        log_msg "Link probe failed, not using compression"
+        return
+    fi
+
+    local haveChoice=0
+    if rsync --version 2>/dev/null | grep -q "Compress list" ; then
+        haveChoice=1
+    fi
+
+    if [ $probeRate -ge 102400 ] ; then
+        compressChoice=none
+    elif [ $haveChoice -eq 0 ] ; then
+        if [ $probeRate -lt 20480 ] ; then
+            compressChoice=zlib
+            compressLevel=6
+        fi
+    elif [ $probeRate -ge 20480 ] && rsync_has_compressor lz4 ; then
+        compressChoice=lz4
+        compressLevel=0
+    elif rsync_has_compressor zstd ; then
+        compressChoice=zstd
+        if [ $probeRate -ge 2048 ] ; then
+            compressLevel=3
+        else
+            compressLevel=9
+        fi
+    else
+        compressChoice=zlib
+        compressLevel=6
+    fi
+
+    if [ "$compressChoice" = "none" ] ; then
+        log_msg "Link speed ${probeRate}KiB/s, not using compression"
+    elif [ $haveChoice -eq 0 ] ; then
+        log_msg "Link speed ${probeRate}KiB/s, using compression"
+        command="$command --compress --compress-level=$compressLevel --skip-compress=$skipCompressList"
+    else
+        log_msg "Link speed ${probeRate}KiB/s, using $compressChoice compression"
+        command="$command --compress-choice=$compressChoice --skip-compress=$skipCompressList"
+        if [ $compressLevel -gt 0 ] ; then
+            command="$command --compress-level=$compressLevel"
+        fi
+    fi
+}
+
+# Replace $1 with stdin - via a new file in the same folder that is flushed to disk before being renamed over $1, with
+# the folder then flushed too. So, after a crash or power loss, $1 holds either its old or its new contents.
+function atomic_write()
+{
+    local tmpFile="$1.tmp.$$"
+
+    # sync only accepts files from coreutils 8.24 - without it, the rename is still atomic, just not durable
+    if cat > "$tmpFile" && { [ ! -e "$1" ] || chmod --reference="$1" "$tmpFile" ; } && \
+       { sync "$tmpFile" 2>/dev/null || true ; } && mv -f "$tmpFile" "$1" ; then
+        sync "`dirname "$1"`" 2>/dev/null
+        return 0
+    fi
+    rm -f "$tmpFile"
+    return 1
+}
+
+# Per-session run history, one record per line: <time> <record type> key=value...
+maxHistory=1000
+
+function add_history()
+{
+    local historyFile="$fileName@CARBON_HISTORY_EXTENSION@"
+    echo "`date +%s` $*" >> "$historyFile"
+    if [ `wc -l < "$historyFile"` -gt `expr $maxHistory \* 2` ] ; then
+        tail -n $maxHistory "$historyFile" | atomic_write "$historyFile"
+    fi
+}
+
+# Outcome of this run. This replaces the session's state file - which is what the GUI's session list shows - and is
+# appended to its history. Verification runs do not synchronise anything, and a run refused because the session is
+# already running says nothing about that session's last run, so neither is recorded.
+function record_run()
+{
+    if [ "$verifyMode" = "true" ] || [ $1 -eq 113 ] || [ ! -f "$fileName" ] ; then
+        return
+    fi
+    local files=`changed_files`
+    local record="exitCode=$1 dryRun=${doDryRun:-false} durationMs=$(( `uptime_ms` - runnerStartMs )) bytes=`transferred_bytes` files=${files:-0}"
+
+    add_history run $record
+    echo "time=`date +%s` $record" | tr ' ' '\n' | atomic_write "$fileName@CARBON_STATE_EXTENSION@"
+}
+
+# Bytes sent+received, from the summary rsync writes to its --log-file
+function transferred_bytes()
+{
+    grep " sent .* bytes  received .* bytes" "$runLogFile" 2>/dev/null | tr -d , | \
+        awk '{ for (i=1; i<NF; i++) { if ($i=="sent" || $i=="received") { total+=$(i+1) } } } END { print total+0 }'
+}
+
+# Number of files created, updated, or deleted - counted from the itemised changes rsync writes to its --log-file.
+# Attribute-only changes are not counted.
+function changed_files()
+{
+    grep -cE '^[0-9/]+ [0-9:]+ \[[0-9]+\] ([<>ch][fdLDS]|\*deleting)' "$runLogFile" 2>/dev/null
+}
+
+# Escape a Prometheus label value
+function metric_label()
+{
+    local v="${1//\\/\\\\}"
+    v="${v//\"/\\\"}"
+    echo "${v//$'\n'/\\n}"
+}
+
+# Write the results of this run as a Prometheus textfile (for node_exporter's textfile collector), to
+# $metricsDir/carbon_<session>.prom - where metricsDir is taken from the session, or CARBON_METRICS_DIR. The file
+# is written to a temporary file, and renamed, so that the collector never sees a partial file. Counting the size
+# of the increments can take a while, so everything runs in the background - at idle priority - and the runner
+# does not wait for it.
+function write_metrics()
+{
+    local rv=$1
+    local dir="${CARBON_METRICS_DIR:-$metricsDir}"
+
+    if [ "$dir" = "" ] || [ "$doDryRun" = "true" ] || [ "$verifyMode" = "true" ] || [ ! -d "$dir" ] ; then
+        return
+    fi
+
+    local now=`date +%s`
+    local durationMs=$(( `uptime_ms` - runnerStartMs ))
+    local bytes=`transferred_bytes`
+    local files=`changed_files`
+    local name=`echo "$sessionName" | tr -c 'A-Za-z0-9_.\n-' '_'`
+    local promFile="$dir/${projectName}_$name.prom"
+    local label="session=\"`metric_label "$sessionName"`\""
+
+    (
+        local lastSuccess=$now
+        if [ $rv -ne 0 ] ; then
+            lastSuccess=`awk '/^carbon_last_success_timestamp_seconds/ { print $NF }' "$promFile" 2>/dev/null`
+        fi
+
+        local increments="$remoteIncrements"
+        local incrementBytes=""
+        if [ "$makeBackups" = "true" ] && [ "$destIsRemote" = "0" ] && [ -d "$dest" ] ; then
+            local incrementDirs=("$dest"/[0-9][0-9][0-9][0-9]-[0-9][0-9]-[0-9][0-9]\ [0-9][0-9]:[0-9][0-9]:[0-9][0-9])
+            if [ -d "${incrementDirs[0]}" ] ; then
+                increments=${#incrementDirs[@]}
+                # du counts hard-linked files once - so this is the space the increments actually use
+                incrementBytes=`nice -n 19 ionice -c 3 du -sbc "${incrementDirs[@]}" 2>/dev/null | tail -n 1 | cut -f 1`
+            else
+                increments=0
+                incrementBytes=0
+            fi
+        fi
+
+        local tmpFile=`mktemp "$dir/.${projectName}_$name.XXXXXX"` || exit
+        {
+            echo "# HELP carbon_last_run_timestamp_seconds Time the last run finished."
+            echo "# TYPE carbon_last_run_timestamp_seconds gauge"
+            echo "carbon_last_run_timestamp_seconds{$label} $now"
+            if [ "$lastSuccess" != "" ] ; then
+                echo "# HELP carbon_last_success_timestamp_seconds Time the last successful run finished."
+                echo "# TYPE carbon_last_success_timestamp_seconds gauge"
+                echo "carbon_last_success_timestamp_seconds{$label} $lastSuccess"
+            fi
+            echo "# HELP carbon_last_run_duration_seconds Duration of the last run."
+            echo "# TYPE carbon_last_run_duration_seconds gauge"
+            echo "carbon_last_run_duration_seconds{$label} `printf "%d.%03d" $((durationMs / 1000)) $((durationMs % 1000))`"
+            echo "# HELP carbon_last_run_exit_code Exit code of the last run, 0 on success."
+            echo "# TYPE carbon_last_run_exit_code gauge"
+            echo "carbon_last_run_exit_code{$label} $rv"
+            echo "# HELP carbon_last_run_transferred_bytes Bytes sent and received by the last run."
+            echo "# TYPE carbon_last_run_transferred_bytes gauge"
+            echo "carbon_last_run_transferred_bytes{$label} ${bytes:-0}"
+            echo "# HELP carbon_last_run_changed_files Files created, updated, or deleted by the last run."
+            echo "# TYPE carbon_last_run_changed_files gauge"
+            echo "carbon_last_run_changed_files{$label} ${files:-0}"
+            if [ "$increments" != "" ] ; then
+                echo "# HELP carbon_increments Number of backup increments."
+                echo "# TYPE carbon_increments gauge"
+                echo "carbon_increments{$label} $increments"
+            fi
+            if [ "$incrementBytes" != "" ] ; then
+                echo "# HELP carbon_increments_bytes Disk space used by all backup increments."
+                echo "# TYPE carbon_increments_bytes gauge"
+                echo "carbon_increments_bytes{$label} $incrementBytes"
+            fi
+        } > "$tmpFile"
+        chmod 644 "$tmpFile"
+        mv -f "$tmpFile" "$promFile"
+    ) < /dev/null > /dev/null 2>&1 &
+}
+
+# Large file profiles. Files at, or above, largeFileSize MiB - or matching largeFilePatterns - are synchronised in
+# separate passes using these options, rather than rsync's defaults.
+#   delta  - databases, etc. Update in place, using large blocks for the delta transfer.
+#   vm     - VM images. As delta, but also keep holes in sparse files.
+#   append - files that only grow (logs, journals). Send the appended data, verifying the existing part.
+#   whole  - fast local disks. Skip the delta algorithm, and preallocate the destination file.
+maxBlockSize=131072
+
+function rsync_version_ge()
+{
+    local have=`rsync --version 2>/dev/null | head -n 1 | awk '{print $3}'`
+    [ "`printf '%s\n%s\n' "$1" "$have" | sort -V | head -n 1`" = "$1" ]
+}
+
+function large_file_options()
+{
+    local profile="$1"
+    local isBackup="$2"
+
+    # Updating in place, or appending, requires an existing copy in the destination folder - whereas each backup
+    # increment starts empty, with unchanged files hard-linked from the previous one. So these fall back to a plain
+    # delta transfer for backups.
+    if [ "$isBackup" = "true" ] && [ "$profile" != "whole" ] ; then
+        echo "--no-whole-file --block-size=$maxBlockSize"
+        return
+    fi
+
+    case "$profile" in
+        delta)
+            echo "--no-whole-file --inplace --block-size=$maxBlockSize"
+            ;;
+        vm)
+            # --sparse may only be combined with --inplace from 3.1.3 onwards
+            if rsync_version_ge 3.1.3 ; then
+                echo "--no-whole-file --inplace --sparse --block-size=$maxBlockSize"
+            else
+                echo "--no-whole-file --sparse --block-size=$maxBlockSize"
+            fi
+            ;;
+        append)
+            echo "--append-verify"
+            ;;
+        whole)
+            echo "--whole-file --preallocate"
+            ;;
+    esac
+}
+
+# Time each profile updating a stale copy of the sample file - i.e. one that has been truncated, and had a block
+# overwritten - and report which is quickest.
+function run_benchmark()
+{
+    local sample="$1"
+    if [ ! -f "$sample" ] ; then
+        log_error_and_exit 102 "Could not read \"$sample\""
+    fi
+
+    local workDir=`mktemp -d "\`dirname "$sample"\`/.$projectName-bench.XXXXXX"`
+    if [ ! -d "$workDir" ] ; then
+        log_error_and_exit 103 "Could not create benchmark folder"
+    fi
+    trap "rm -rf \"$workDir\"" EXIT
+
+    local size=`stat --format=%s "$sample"`
+    local best=""
+    local bestMs=0
+    local profile start end ms
+    log_msg "Benchmarking `basename "$sample"` (`expr $size / 1048576` MiB)"
+
+    for profile in default delta vm append whole ; do
+        cp --reflink=auto "$sample" "$workDir/stale"
+        truncate --size=`expr $size / 10 \* 9` "$workDir/stale"
+        dd if=/dev/urandom of="$workDir/stale" bs=1M count=1 seek=`expr $size / 2097152` conv=notrunc status=none
+        sync
+
+        start=`date +%s%N`
+        if [ "$profile" = "default" ] ; then
+            rsync --times --ignore-times "$sample" "$workDir/stale"
+        else
+            rsync --times --ignore-times `large_file_options $profile false` "$sample" "$workDir/stale"
+        fi
+        sync
+        end=`date +%s%N`
+        let ms="($end - $start) / 1000000"
+
+        if cmp -s "$sample" "$workDir/stale" ; then
+            log_msg "$profile: ${ms}ms"
+            if [ "$best" = "" ] || [ $ms -lt $bestMs ] ; then
+                best=$profile
+                bestMs=$ms
+            fi
+        else
+            log_msg "$profile: ${ms}ms (copy does not match, ignored)"
+        fi
+        rm -f "$workDir/stale"
+    done
+
+    if [ "$best" != "" ] ; then
+        log_msg "Quickest profile: $best"
+    fi
+}
+
+# Filesystem type that can be snapshotted, containing $1 - or nothing
+function snapshot_type()
+{
+    case "`findmnt -n -o FSTYPE --target "$1" 2>/dev/null`" in
+    btrfs) echo btrfs ;;
+    zfs)   echo zfs ;;
+    *)     if lvs "`findmnt -n -o SOURCE --target "$1"`" > /dev/null 2>&1 ; then echo lvm ; fi ;;
+    esac
+}
+
+# Take a read-only snapshot, of type $1, of the filesystem containing the local folder $2. On success, syncSrc is
+# set to the folder's path within the snapshot, and release_snapshot (called on exit) removes it. Snapshots left by
+# an earlier run, that did not get to remove them, are replaced.
+function take_snapshot()
+{
+    local path="${2%/}"
+    local mnt=`findmnt -n -o TARGET --target "$path" 2>/dev/null`
+    local dev=`findmnt -n -o SOURCE --target "$path" 2>/dev/null`
+    local name="$projectName-`echo "$sessionName" | tr -c 'A-Za-z0-9_.\n-' '_'`"
+    local rel
+
+    if [ "$mnt" = "" ] ; then
+        return 1
+    fi
+
+    case $1 in
+    btrfs)
+        # Snapshot the subvolume containing the folder - subvolume roots have inode 256. Nested subvolumes are not
+        # part of a snapshot, so the snapshot is placed inside the subvolume.
+        local subvol="$path"
+        while [ "`stat -c %i "$subvol" 2>/dev/null`" != "256" ] && [ "$subvol" != "$mnt" ] && [ "$subvol" != "/" ] ; do
+            subvol=`dirname "$subvol"`
+        done
+        snapshotPath="${subvol%/}/.$name"
+        if [ -d "$snapshotPath" ] ; then
+            btrfs subvolume delete "$snapshotPath" > /dev/null 2>&1
+        fi
+        btrfs subvolume snapshot -r "$subvol" "$snapshotPath" > /dev/null || return 1
+        rel="${path#"${subvol%/}"}"
+        syncSrc="$snapshotPath$rel/"
+        ;;
+    lvm)
+        local lv=`lvs --noheadings -o vg_name,lv_name "$dev" 2>/dev/null | awk '{ print $1 "/" $2 }'`
+        local pool=`lvs --noheadings -o pool_lv "$dev" 2>/dev/null | tr -d ' '`
+        local fsType=`findmnt -n -o FSTYPE --target "$path"`
+        local mountOpts=ro
+        snapshotPath="${lv%/*}/$name"
+        lvremove -f "$snapshotPath" > /dev/null 2>&1
+        if [ "$pool" != "" ] ; then
+            # Thin snapshots need no space reserving, but are not activated by default
+            lvcreate --snapshot --name "$name" --setactivationskip n --activate y "$lv" > /dev/null || return 1
+        else
+            lvcreate --snapshot --name "$name" --extents "${snapshotSize:-10%ORIGIN}" "$lv" > /dev/null || return 1
+        fi
+        if [ "$fsType" = "xfs" ] ; then
+            mountOpts="$mountOpts,nouuid"
+        fi
+        snapshotMount=`mktemp -d "${TMPDIR:-/tmp}/$name.XXXXXX"`
+        if ! mount -o $mountOpts "/dev/$snapshotPath" "$snapshotMount" ; then
+            rmdir "$snapshotMount"
+            lvremove -f "$snapshotPath" > /dev/null 2>&1
+            return 1
+        fi
+        rel="${path#"${mnt%/}"}"
+        syncSrc="$snapshotMount$rel/"
+        ;;
+    zfs)
+        # Snapshots are reached through the dataset's .zfs folder, so do not need mounting
+        snapshotPath="$dev@$name"
+        zfs destroy "$snapshotPath" > /dev/null 2>&1
+        zfs snapshot "$snapshotPath" || return 1
+        rel="${path#"${mnt%/}"}"
+        syncSrc="${mnt%/}/.zfs/snapshot/$name$rel/"
+        ;;
+    *)
+        return 1
+        ;;
+    esac
+
+    snapshotType=$1
+    trap release_snapshot EXIT
+    return 0
+}
+
+function release_snapshot()
+{
+    case "$snapshotType" in
+    btrfs)
+        btrfs subvolume delete "$snapshotPath" > /dev/null
+        ;;
+    lvm)
+        umount "$snapshotMount" && rmdir "$snapshotMount"
+        lvremove -f "$snapshotPath" > /dev/null
+        ;;
+    zfs)
+        zfs destroy "$snapshotPath"
+        ;;
+    esac
+    snapshotType=""
+}
+
+# Split the source's top-level folders into $1 shards, of roughly equal weight (bytes, plus an allowance per file),
+# from a single find pass. Each shard is written to $shardDir/<n> as a list of anchored rsync include patterns.
+function create_shards()
+{
+    find "$syncSrc" -mindepth 1 -printf '%y %s %P\n' 2>/dev/null | \
+        awk '{ path=substr($0, length($1)+length($2)+3); n=index(path, "/");
+               if (n) { weight[substr(path, 1, n-1)]+=$2+4096 } else if ("d"==$1) { weight[path]+=4096 } }
+             END { for (p in weight) { printf "%d\t%s\n", weight[p], p } }' | \
+        sort -t $'\t' -k1,1nr | \
+        awk -F $'\t' -v shards=$1 -v dir="$shardDir" \
+            '{ best=0; for (i=1; i<shards; i++) { if (load[i]<load[best]) { best=i } }
+               load[best]+=$1; name=$2; gsub(/[][*?\\]/, "\\\\&", name); print "/" name > (dir "/" best) }'
+}
+
+# Run the main pass as one non-recursive rsync for the top level of the source (which also deletes extraneous
+# top-level entries), followed by parallel rsyncs each restricted to their own shard of top-level folders. As other
+# shards' folders are excluded, --delete in one shard can never touch another's. Progress lines are tagged with the
+# shard number, so that the GUI can combine them.
+function run_sharded()
+{
+    local shards=$1
+    local shardFile shard
+    shardDir=`mktemp -d "$cacheDir/shards.XXXXXX"`
+    create_shards $shards
+
+    # Skip folders completed by the run being resumed
+    local completed=0
+    if [ "$resuming" = "true" ] && grep -q "^done=" "$checkpointFile" ; then
+        sed -n 's/^done=//p' "$checkpointFile" > "$shardDir.done"
+        completed=`wc -l < "$shardDir.done"`
+        for shardFile in "$shardDir"/* ; do
+            grep -vxF -f "$shardDir.done" "$shardFile" > "$shardFile.tmp"
+            mv "$shardFile.tmp" "$shardFile"
+            if [ ! -s "$shardFile" ] ; then
+                rm "$shardFile"
+            fi
+        done
+        rm -f "$shardDir.done"
+        log_msg "Skipping $completed folder(s) completed by the interrupted run"
+    fi
+
+    local shardFiles=("$shardDir"/*)
+    if [ ! -f "${shardFiles[0]}" ] ; then
+        shardFiles=()
+    fi
+    if [ $completed -eq 0 ] && [ ${#shardFiles[@]} -lt 2 ] ; then
+        rm -rf "$shardDir"
+        log_msg "Not enough folders to run in parallel"
+        $command "${mainArgs[@]}"
+        rsyncRv=$?
+        return
+    fi
+
+    log_msg "Synchronising top level"
+    $command "${mainArgs[@]}" --no-recursive --dirs
+    rsyncRv=$?
+    if [ $rsyncRv -ne 0 ] ; then
+        rm -rf "$shardDir"
+        return
+    fi
+
+    log_msg "Synchronising in ${#shardFiles[@]} parallel shards"
+    local pids=()
+    for shardFile in "${shardFiles[@]}" ; do
+        shard=`basename "$shardFile"`
+        ( set -o pipefail
+          $command "${mainArgs[@]}" --include-from="$shardFile" "--exclude=/*" | \
+              stdbuf -o0 tr '\r' '\n' | sed -u "s|^|@CARBON_SHARD_PREFIX@$shard:|" ) &
+        pids+=($!)
+    done
+
+    local i
+    for i in "${!pids[@]}" ; do
+        wait ${pids[$i]}
+        local shardRv=$?
+        if [ $shardRv -eq 0 ] && [ "$checkpointing" = "true" ] ; then
+            # Record the shard's folders as complete, should this run be interrupted
+            sed 's/^/done=/' "${shardFiles[$i]}" >> "$checkpointFile"
+        elif [ $rsyncRv -eq 0 ] ; then
+            rsyncRv=$shardRv
+        fi
+    done
+    rm -rf "$shardDir"
+}
+
+# Backup verification. Each increment has a catalog, listing the content hash of each of its files:
+#   # carbon-catalog 1 <algorithm>
+#   <inode> <size> <mtime> <hash> <path>
+# Files that did not change are hard links to those in the previous increment - so their hashes are copied from its
+# catalog, and only new files are read. Files whose name contains a newline are not catalogued.
+catalogName=".$projectName-catalog"
+verifyJobs=`nproc 2>/dev/null || echo 1`
+if [ $verifyJobs -gt 4 ] ; then
+    verifyJobs=4
+fi
+
+function hash_algorithm()
+{
+    if which b3sum > /dev/null 2>&1 ; then
+        echo blake3
+    elif xxhsum -H3 /dev/null > /dev/null 2>&1 ; then
+        echo xxh3
+    else
+        echo sha256
+    fi
+}
+
+# Hash the NUL separated list of files read from stdin, in parallel, and at idle I/O priority. Writes "<hash> <path>"
+# lines. Each hashing process writes to its own file, so that their output can not interleave.
+function hash_files()
+{
+    local cmd
+    case "$1" in
+        blake3) cmd="b3sum" ;;
+        xxh3)   cmd="xxhsum -H3" ;;
+        *)      cmd="sha256sum" ;;
+    esac
+
+    local outDir=`mktemp -d "$cacheDir/hash.XXXXXX"`
+    nice -n 19 ionice -c 3 xargs -0 -r -n 256 -P $verifyJobs sh -c "exec $cmd \"\$@\" > \"\$0/\$\$\" 2>/dev/null" "$outDir"
+    # Names containing a backslash are escaped, and the line prefixed with one
+    cat "$outDir"/* 2>/dev/null | \
+        awk '{ esc=0; if (substr($0, 1, 1)=="\\") { esc=1; $0=substr($0, 2) }
+               h=$1; sub(/^XXH3_/, "", h); p=substr($0, length($1)+3); sub(/^\.\//, "", p);
+               if (esc) { gsub(/\\\\/, "\\", p) } print h " " p }'
+    rm -rf "$outDir"
+}
+
+# List the files of an increment as "<inode> <size> <mtime> <path>"
+function list_increment()
+{
+    ( cd "$1" && find . -type f ! -name "$catalogName*" ! -path "./*.$projectName-partial/*" ! -name "*"$'\n'"*" \
+                     -printf '%i %s %T@ %P\n' )
+}
+
+# Write the catalog of increment $1, reusing the hashes of increment $2's
+function build_catalog()
+{
+    local dir="$1"
+    local prev="$2"
+    local algorithm=`hash_algorithm`
+    local work=`mktemp -d "$cacheDir/catalog.XXXXXX"`
+
+    list_increment "$dir" > "$work/files"
+    touch "$work/previous"
+    if [ "$prev" != "" ] && [ -f "$prev/$catalogName" ] && [ "`head -n 1 "$prev/$catalogName"`" = "# carbon-catalog 1 $algorithm" ] ; then
+        tail -n +2 "$prev/$catalogName" > "$work/previous"
+    fi
+
+    # Hard links share the inode, size, and mtime
+    awk -v known="$work/known" -v todo="$work/todo" \
+        'FILENAME==ARGV[1] { hash[$1" "$2" "$3]=$4; next }
+         { key=$1" "$2" "$3; if (key in hash) { print $1, $2, $3, hash[key], substr($0, length(key)+2) > known }
+           else { print "./" substr($0, length(key)+2) > todo } }' "$work/previous" "$work/files"
+    touch "$work/known" "$work/todo"
+    log_msg "Cataloguing `wc -l < "$work/todo"` new file(s), `wc -l < "$work/known"` unchanged"
+
+    ( cd "$dir" && tr '\n' '\0' < "$work/todo" | hash_files $algorithm ) > "$work/hashes"
+    { echo "# carbon-catalog 1 $algorithm"
+      cat "$work/known"
+      awk 'FILENAME==ARGV[1] { hash[substr($0, length($1)+2)]=$1; next }
+           { key=$1" "$2" "$3; p=substr($0, length(key)+2); if (p in hash) { print $1, $2, $3, hash[p], p } }' \
+          "$work/hashes" "$work/files"
+    } > "$dir/$catalogName.tmp" && mv -f "$dir/$catalogName.tmp" "$dir/$catalogName"
+    rm -rf "$work"
+}
+
+# Verify increments against their catalogs. Every file's inode, size, and mtime is checked. Content is hashed once
+# per inode - and, if maxAge days is given, only if it has not been verified within that time. Verified inodes are
+# remembered in the cache, so that verification can run incrementally, e.g. a little each night.
+function verify_increments()
+{
+    local maxAge=$1
+    shift
+    local stateFile="$cacheDir/$sessionName@CARBON_VERIFY_EXTENSION@"
+    local work=`mktemp -d "$cacheDir/verify.XXXXXX"`
+    local now=`date +%s`
+    local failed=0
+    local increment algorithm
+
+    touch "$stateFile" "$work/expected" "$work/actual"
+    for increment in "$@" ; do
+        local name=`basename "$increment"`
+        if [ ! -f "$increment/$catalogName" ] ; then
+            log_error "$name has no catalog"
+            failed=1
+            continue
+        fi
+        algorithm=`head -n 1 "$increment/$catalogName" | awk '{ print $4 }'`
+        if [ "$algorithm" != "`hash_algorithm`" ] ; then
+            log_error "$name was catalogued with $algorithm, which is not available"
+            failed=1
+            continue
+        fi
+        tail -n +2 "$increment/$catalogName" | awk -v inc="$name" '{ print inc "/" substr($0, length($1" "$2" "$3" "$4)+2) "\t" $1" "$2" "$3" "$4 }' >> "$work/expected"
+        list_increment "$increment" | awk -v inc="$name" '{ print inc "/" substr($0, length($1" "$2" "$3)+2) "\t" $1" "$2" "$3 }' >> "$work/actual"
+    done
+
+    # Compare metadata, and pick one path for each inode that needs hashing
+    awk -F '\t' -v state="$stateFile" -v now=$now -v maxAge=$(( maxAge * 86400 )) \
+        -v todo="$work/todo" -v report="$work/report" \
+        'FILENAME==state { split($0, s, " "); verified[s[1]" "s[2]" "s[3]]=s[4]; next }
+         FILENAME ~ /actual$/ { actual[$1]=$2; next }
+         { split($2, e, " "); key=e[1]" "e[2]" "e[3]
+           if (!($1 in actual)) { print "Missing: " $1 > report; next }
+           if (actual[$1] != key) { print "Modified: " $1 > report; next }
+           if (key in queued) { next }
+           queued[key]=1
+           if (maxAge > 0 && (key in verified) && now - verified[key] < maxAge) { skipped++; next }
+           print $1 "\t" key " " e[4] > todo }
+         END { print skipped+0 }' "$stateFile" "$work/actual" "$work/expected" > "$work/skipped"
+    touch "$work/todo" "$work/report"
+    log_msg "Verifying `wc -l < "$work/todo"` file(s), `cat "$work/skipped"` recently verified"
+
+    if [ -s "$work/todo" ] ; then
+        ( cd "$dest" && cut -f 1 "$work/todo" | tr '\n' '\0' | hash_files $algorithm ) > "$work/hashes"
+        awk -F '\t' -v state="$stateFile.tmp" -v report="$work/report" -v now=$now \
+            'FILENAME==ARGV[1] { p=index($0, " "); hash[substr($0, p+1)]=substr($0, 1, p-1); next }
+             { split($2, e, " ")
+               if (hash[$1] == e[4]) { print e[1], e[2], e[3], now > state }
+               else { print "Corrupt: " $1 > report } }' "$work/hashes" "$work/todo"
+        # Keep the time that inodes which were skipped were last verified
+        touch "$stateFile.tmp"
+        awk 'FILENAME==ARGV[1] { done[$1" "$2" "$3]=1; print; next } !($1" "$2" "$3 in done)' "$stateFile.tmp" "$stateFile" > "$stateFile.new"
+        mv -f "$stateFile.new" "$stateFile"
+        rm -f "$stateFile.tmp"
+    fi
+
+    if [ -s "$work/report" ] ; then
+        while IFS= read -r line ; do
+            log_error "$line"
+        done < "$work/report"
+        failed=1
+    fi
+    log_msg "Verification found `wc -l < "$work/report"` problem(s)"
+    rm -rf "$work"
+    return $failed
+}
+
+if [ "$benchmarkFile" != "" ] ; then
+    run_benchmark "$benchmarkFile"
+    exit 0
+fi
+
 if [ "$fileName" = "" ]; then
     show_help
 fi
@@ -142,13 +1106,38 @@ if [ "$@CARBON_GUI_PARENT@" != "true" ] ; then
 
     # We are not being run via the GUI - so we need to log all output
     # So re-run this script, but capture all output to log file...
-    @CARBON_GUI_PARENT@=true CARBON_NO_MSG_PREFIX=true $0 "$@" > "$fileName@CARBON_LOG_EXTENSION@" 2>&1
+    @CARBON_GUI_PARENT@=true CARBON_NO_MSG_PREFIX=true $0 "${runnerArgs[@]}" > "$fileName@CARBON_LOG_EXTENSION@" 2>&1
 else
+    phase startup $runnerStartMs
     notify 0 start
     eval `cat "$fileName" | grep -A999 "\[Settings\]" | tail -n +2`
     src=`fix_url $src`
     dest=`fix_url $dest`
 
+    # Store PID in lock file, to prevent multiple executions. This is taken before the pre-sync command, so that two
+    # runs of the session can not both run it.
+    echo $$ > "$fileName@CARBON_LOCK_EXTENSION@"
+    lockTaken=true
+
+    # The session's commands are not run for dry runs, or verification. The pre-sync command runs before the source
+    # and destination are checked, so that it may mount them.
+    hooksEnabled=false
+    if [ "$doDryRun" != "true" ] && [ "$verifyMode" != "true" ] ; then
+        hooksEnabled=true
+        if [ "$preCommand" != "" ] ; then
+            trap cancelled TERM INT
+            phase command
+            run_hook pre-sync "$preCommand"
+            preRv=$?
+            if [ $preRv -ne 0 ] ; then
+                if [ "$preCommandHalt" != "false" ] ; then
+                    log_error_and_exit 116 "Pre-sync command failed"
+                fi
+                log_error "Pre-sync command failed ($preRv), continuing"
+            fi
+        fi
+    fi
+
     if [ -z "$src" ] ; then
         log_error_and_exit 109 "Source is empty"
     fi
@@ -179,15 +1168,17 @@ else
     if [ "$skipReceiverNewerFiles" = "true" ] || [ "$skipReceiverNewerFiles" = "" ]; then command="$command --update"; fi
     if [ "$keepPartial" = "true" ]; then command="$command --partial"; fi
     if [ "$onlyUpdate" = "true" ]; then command="$command --existing"; fi
-    if [ "$useCompression" = "true" ]; then command="$command --compress"; fi
+    if [ "$useCompression" = "true" ]; then command="$command --compress --skip-compress=$skipCompressList"; fi
     if [ "$checksum" = "true" ]; then command="$command --checksum"; fi
     if [ "$windowsCompat" = "true" ]; then command="$command --modify-window=1"; fi
     if [ "$ignoreExisting" = "true" ]; then command="$command --ignore-existing"; fi
     if [ "$archive" != "true" ] && ( [ "$preservePermissions" = "true" ] || [ "$preservePermissions" = "" ] ) ; then command="$command --perms"; fi
     if [ "$archive" != "true" ] && ( [ "$preserveGroup" = "true" ] || [ "$preserveGroup" = "" ] ) ; then command="$command --group"; fi
     if [ "$modificationTimes" = "true" ] || [ "$modificationTimes" = "" ]; then command="$command --times"; fi
+    # --delete is passed to each pass that should delete, rather than being part of $command
+    deleteOption=""
     if ( [ "$deleteExtraFilesOnReceiver" = "true" ] || [ "$deleteExtraFilesOnReceiver" = "" ] ) && [ "$recursive" != "false" ] ; then
-         command="$command --delete";
+         deleteOption="--delete"
     fi
     if [ "$archive" != "true" ] && ( [ "$preserveOwner" = "true" ] || [ "$preserveOwner" = "" ] ) ; then command="$command --owner"; fi
     if [ "$archive" != "true" ] && ( [ "$preserveSpecialFiles" = "true" ] || [ "$preserveSpecialFiles" = "" ] ) ; then command="$command -D"; fi
@@ -206,10 +1197,96 @@ else
         log_error_and_exit 103 "$dest does not exist"
     fi
 
+    if [ "$verifyMode" = "true" ] ; then
+        if [ "$makeBackups" != "true" ] || [ $destIsRemote -ne 0 ] ; then
+            log_error_and_exit 115 "Only local backups can be verified"
+        fi
+        if [ "$verifyIncrement" != "" ] ; then
+            increments=("$dest/$verifyIncrement")
+        else
+            increments=("$dest"/[0-9][0-9][0-9][0-9]-[0-9][0-9]-[0-9][0-9]\ [0-9][0-9]:[0-9][0-9]:[0-9][0-9])
+        fi
+        if [ ! -d "${increments[0]}" ] ; then
+            log_error_and_exit 115 "No increments to verify"
+        fi
+
+        trap cancelled TERM INT
+        mkdir -p "$cacheDir"
+        phase verify
+        verify_increments "${verifyAge:-0}" "${increments[@]}"
+        rv=$?
+        if [ $rv -ne 0 ] ; then
+            rv=114
+        fi
+        rm "$fileName@CARBON_LOCK_EXTENSION@"
+        phase end
+        exit $rv
+    fi
+
     excludeFrom="$fileName@CARBON_EXCLUDE_EXTENSION@"
 
+    # A checkpoint is written when a run starts, and removed once it succeeds. If one exists, then the previous run
+    # was interrupted - so resume it. Backups continue into the same increment, and sharded runs skip the folders
+    # that were completed.
+    checkpointFile="$fileName@CARBON_CHECKPOINT_EXTENSION@"
+    checkpointing=false
+    resuming=false
+    if [ "$doDryRun" != "true" ] && [ "$changesFile" = "" ] && [ -f "$checkpointFile" ] ; then
+        if [ "`sed -n 's/^src=//p' "$checkpointFile"`" = "$src" ] && [ "`sed -n 's/^dest=//p' "$checkpointFile"`" = "$dest" ] ; then
+            resuming=true
+        else
+            rm -f "$checkpointFile"
+        fi
+    fi
+
+    remoteHost=""
+    sshCommand=""
+    if [ $srcIsRemote -eq 1 ] && is_ssh_location "$src" ; then
+        remoteHost=`remote_host "$src"`
+    elif [ $destIsRemote -eq 1 ] && is_ssh_location "$dest" ; then
+        remoteHost=`remote_host "$dest"`
+        remoteDestPath=`remote_path "$dest"`
+    fi
+
+    if [ "$remoteHost" != "" ] ; then
+        phase connect
+        if [ "$useCompression" = "auto" ] ; then
+            # Prefer ciphers that are hardware accelerated, or cheap in software
+            sshCipherOpts="-c aes128-gcm@openssh.com,chacha20-poly1305@openssh.com,aes128-ctr"
+        fi
+        if ssh_start_master "$remoteHost" ; then
+            sshCommand=`ssh_command`
+        else
+            log_msg "Could not start shared ssh connection to $remoteHost"
+        fi
+    fi
+
+    if [ "$useCompression" = "auto" ] ; then
+        phase probe
+        select_compression
+    fi
+
     if [ "$doDryRun" = "true" ]; then
         command="$command -n"
+        if [ "$CARBON_NO_MSG_PREFIX" != "true" ] ; then
+            # Itemise changes, so that the GUI can build a change set. No spaces, as $command is word split.
+            command="${command/--out-format=@CARBON_PREFIX@%f/--out-format=@CARBON_ITEM_PREFIX@%i|%l|%n}"
+        fi
+    fi
+
+    if [ "$changesFile" != "" ] ; then
+        if [ ! -f "$changesFile" ] ; then
+            log_msg "Change set does not exist, performing full synchronisation"
+            changesFile=""
+        elif [ "$makeBackups" = "true" ] ; then
+            # An increment must contain everything, not just what changed
+            log_msg "Change sets can not be used for backups, performing full synchronisation"
+            changesFile=""
+        else
+            # Deleted entries are in the list, so --delete-missing-args removes them. --delete would need --recursive.
+            deleteOption=""
+            command="$command --no-recursive --delete-missing-args"
+        fi
     fi
 
     destFolder="$dest"
@@ -220,12 +1297,32 @@ else
         currentBackupTimeFile="$fileName@CARBON_INFO_EXTENSION@"
         previousBackupTime=`cat "$currentBackupTimeFile" | grep "$backupTimeKey" | awk -F\= '{print $2}'`
 
+        if [ "$resuming" = "true" ] ; then
+            resumeBackupTime=`sed -n 's/^increment=//p' "$checkpointFile"`
+            if [ "$resumeBackupTime" != "" ] && \
+               ( ( [ $destIsRemote -eq 0 ] && [ -d "$dest/$resumeBackupTime" ] ) || \
+                 ( [ $destIsRemote -eq 1 ] && [ "$sshCommand" != "" ] && remote_exec "$remoteHost" test -d `shell_quote "$remoteDestPath$resumeBackupTime"` ) ) ; then
+                log_msg "Resuming interrupted backup $resumeBackupTime"
+                currentBackupTime="$resumeBackupTime"
+                # The .info file may already name the interrupted increment
+                previousBackupTime=`sed -n 's/^previous=//p' "$checkpointFile"`
+            else
+                log_msg "Interrupted backup no longer exists, starting a new one"
+                resuming=false
+            fi
+        fi
+
         if [ -f "$dest$currentBackupTime" ] ; then
             log_error_and_exit 104 " $dest$currentBackupTime is a file!"
         fi
 
         if [ ! -z "$previousBackupTime" ] ; then
-            linkDestFolder="$dest/$previousBackupTime"
+            if [ $destIsRemote -eq 0 ] ; then
+                linkDestFolder="$dest/$previousBackupTime"
+            else
+                # --link-dest is a path on the receiver - relative paths are relative to the destination folder
+                linkDestFolder="../$previousBackupTime"
+            fi
         fi
         if [ ! -z "$currentBackupTime" ] ; then
             destFolder="$dest/$currentBackupTime"
@@ -236,36 +1333,190 @@ else
         elif [ $destIsRemote -eq 0 ] && [ ! -d "$linkDestFolder" ] ; then
             log_msg "Full backup, as previous folder does not exist"
             linkDestFolder=""
+        elif [ $destIsRemote -eq 1 ] && [ "$sshCommand" != "" ] && ! remote_exec "$remoteHost" test -d `shell_quote "$remoteDestPath$previousBackupTime"` ; then
+            log_msg "Full backup, as previous folder does not exist"
+            linkDestFolder=""
         else
             log_msg "Incremental backup (previous $linkDestFolder)"
         fi
     fi
 
-    # Store PID in lock file, to prevent multiple executions...
-    echo $$ > "$fileName@CARBON_LOCK_EXTENSION@"
+    trap cancelled TERM INT
 
-    if [ "$linkDestFolder" = "" ] ; then
-        # linkDest is empty, so dont pass as arg - else rsync moans...
-        if [ -f "$excludeFrom" ] ; then
-            $command "$src" "$destFolder" --exclude-from="$excludeFrom"
+    # Synchronise from a snapshot of the source, if set. Dry runs use the live source, as they make no copy.
+    syncSrc="$src"
+    if [ "$snapshot" != "" ] && [ "$snapshot" != "none" ] && [ $srcIsRemote -eq 0 ] && [ "$doDryRun" != "true" ] ; then
+        snapshotKind=$snapshot
+        if [ "$snapshot" = "auto" ] ; then
+            snapshotKind=`snapshot_type "$src"`
+        fi
+        if [ "$snapshotKind" = "" ] ; then
+            log_msg "Source's filesystem does not support snapshots, using the live source"
+        else
+            phase snapshot
+            if take_snapshot "$snapshotKind" "$src" ; then
+                log_msg "Synchronising from $snapshotKind snapshot $snapshotPath"
+            elif [ "$snapshot" = "auto" ] ; then
+                log_error "Could not take $snapshotKind snapshot of source, using the live source"
+            else
+                log_error_and_exit 117 "Could not take $snapshotKind snapshot of source"
+            fi
+        fi
+    fi
+
+    if [ "$doDryRun" != "true" ] && [ "$changesFile" = "" ] ; then
+        checkpointing=true
+        if [ "$resuming" = "true" ] ; then
+            if [ "$makeBackups" != "true" ] ; then
+                log_msg "Resuming interrupted synchronisation"
+            fi
         else
-            $command "$src" "$destFolder"
+            { echo "src=$src"
+              echo "dest=$dest"
+              echo "increment=$currentBackupTime"
+              echo "previous=$previousBackupTime"; } | atomic_write "$checkpointFile"
         fi
+    fi
+
+    if [ "$changesFile" != "" ] ; then
+        # Item names are relative to the source folder - as both the names rsync lists for a dry run, and those
+        # recorded by --watch, are. fix_url gives src a trailing slash, but a snapshot path might lack one.
+        rsyncArgs=("${syncSrc%/}/" "$destFolder" --files-from="$changesFile")
     else
-        if [ -f "$excludeFrom" ] ; then
-            $command "$src" "$destFolder" --exclude-from="$excludeFrom" --link-dest="$linkDestFolder"
+        rsyncArgs=("$syncSrc" "$destFolder")
+    fi
+    if [ -f "$excludeFrom" ] ; then
+        rsyncArgs+=(--exclude-from="$excludeFrom")
+    fi
+    # If linkDest is empty, dont pass as arg - else rsync moans...
+    if [ "$linkDestFolder" != "" ] ; then
+        rsyncArgs+=(--link-dest="$linkDestFolder")
+    fi
+    if [ "$sshCommand" != "" ] ; then
+        rsyncArgs+=(-e "$sshCommand")
+    fi
+
+    mkdir -p "$cacheDir"
+    runLogFile="$cacheDir/$sessionName@CARBON_LOG_EXTENSION@"
+    rm -f "$runLogFile"
+    rsyncArgs+=(--log-file="$runLogFile")
+
+    # Large files are synchronised after everything else, in their own passes, using the session's large file
+    # profile options. Files above the size limit are still in the first pass's file list, so that pass deletes those
+    # that were removed from the source. Files matching the patterns are excluded from it, which also protects them
+    # from its --delete - so the pattern pass deletes them itself. (Hiding them from the sender only, with -s, would
+    # have the first pass delete every one of them, and the pattern pass copy them all again.)
+    mainArgs=("${rsyncArgs[@]}")
+    if [ "$deleteOption" != "" ] ; then
+        mainArgs+=("$deleteOption")
+    fi
+    largeFilePasses=()
+    if [ "$largeFileProfile" != "" ] && [ "$largeFileProfile" != "none" ] ; then
+        read -r -a largeFilePatternList <<< "$largeFilePatterns"
+
+        for pattern in "${largeFilePatternList[@]}" ; do
+            mainArgs+=(--exclude="$pattern")
+        done
+
+        if [ "$largeFileSize" != "" ] && [ $largeFileSize -gt 0 ] && ( [ $maxFileSize -eq 0 ] || [ $maxFileSize -gt $largeFileSize ] ) ; then
+            mainArgs+=(--max-size=`expr $largeFileSize \* 1048576 - 1`)
+            largeFilePasses+=(size)
+        fi
+        if [ ${#largeFilePatternList[@]} -gt 0 ] ; then
+            largeFilePasses+=(patterns)
+        fi
+        largeCommand="$command `large_file_options "$largeFileProfile" "$makeBackups"`"
+    fi
+
+    if [ "$changesFile" != "" ] ; then
+        # Only the listed files are transferred, so there is no scan to split up
+        mainArgs=("${rsyncArgs[@]}")
+        largeFilePasses=()
+    fi
+
+    # Keep partially transferred files, so that an interrupted run can continue them. A relative --partial-dir is
+    # protected from --delete. rsync does not allow it with --inplace, or --append - files updated in place need no
+    # partial copy anyway.
+    partialDirArg=""
+    if [ "$doDryRun" != "true" ] ; then
+        partialDirArg="--partial-dir=.$projectName-partial"
+        if [[ "$command" != *--inplace* ]] && [[ "$command" != *--append* ]] ; then
+            mainArgs+=("$partialDirArg")
+        fi
+    fi
+
+    phase scan
+    rsyncStart=`date +%s%N`
+    if [ "$parallelShards" != "" ] && [ $parallelShards -gt 1 ] && [ $srcIsRemote -eq 0 ] && [ "$recursive" != "false" ] && \
+       [ "$changesFile" = "" ] && [[ "$command" != *--delete-excluded* ]] ; then
+        run_sharded $parallelShards
+    else
+        $command "${mainArgs[@]}"
+        rsyncRv=$?
+    fi
+
+    for largePass in "${largeFilePasses[@]}" ; do
+        if [ $rsyncRv -ne 0 ] ; then
+            break
+        fi
+        phase large
+        largeArgs=("${rsyncArgs[@]}")
+        if [ "$partialDirArg" != "" ] && [[ "$largeCommand" != *--inplace* ]] && [[ "$largeCommand" != *--append* ]] ; then
+            largeArgs+=("$partialDirArg")
+        fi
+        if [ "$largePass" = "size" ] ; then
+            # Files matching the patterns are handled by their own pass
+            for pattern in "${largeFilePatternList[@]}" ; do
+                largeArgs+=(--exclude="$pattern")
+            done
+            largeArgs+=(--min-size=${largeFileSize}M)
         else
-            $command "$src" "$destFolder" --link-dest="$linkDestFolder"
+            for pattern in "${largeFilePatternList[@]}" ; do
+                largeArgs+=(--include="$pattern")
+            done
+            # Everything else is excluded, and so protected from --delete. Empty folders are not pruned, as the
+            # receiver would then delete those that it still has.
+            largeArgs+=("--include=*/" "--exclude=*")
+            if [ "$deleteOption" != "" ] ; then
+                largeArgs+=("$deleteOption")
+            else
+                largeArgs+=(--prune-empty-dirs)
+            fi
         fi
+        log_msg "Synchronising large files"
+        $largeCommand "${largeArgs[@]}"
+        rsyncRv=$?
+    done
+    rsyncEnd=`date +%s%N`
+    release_snapshot
+
+    if [ "$useCompression" = "auto" ] && [ "$doDryRun" != "true" ] && [ $rsyncRv -eq 0 ] && [ "$sshCommand" != "" ] ; then
+        let rsyncMs="($rsyncEnd - $rsyncStart) / 1000000 + 1"
+        let transferRate="`transferred_bytes` * 1000 / 1024 / $rsyncMs"
+        add_history compression choice=$compressChoice level=$compressLevel probe=$probeRate rate=$transferRate
     fi
 
-    if [ "$makeBackups" = "true" ] && [ -d "$destFolder" ] ; then
-        # Store date of this backup
-        echo "$backupTimeKey=$currentBackupTime" > "$currentBackupTimeFile"
+    rv=$rsyncRv
+
+    # Only a complete increment may become the base (--link-dest) of the next one. 24 is "source files vanished",
+    # which live sources often have - the increment is still complete apart from those files.
+    if [ "$makeBackups" = "true" ] && [ "$doDryRun" != "true" ] && ( [ $rv -eq 0 ] || [ $rv -eq 24 ] ) && \
+       [ -d "$destFolder" ] ; then
+        echo "$backupTimeKey=$currentBackupTime" | atomic_write "$currentBackupTimeFile"
     fi
 
-    rv=$?
+    # A run that completed its increment must not be resumed into it
+    if ( [ $rv -eq 0 ] || [ $rv -eq 24 ] ) && [ "$checkpointing" = "true" ] ; then
+        rm -f "$checkpointFile"
+    fi
+
+    if ( [ $rv -eq 0 ] || [ $rv -eq 24 ] ) && [ "$hashCatalog" = "true" ] && [ "$makeBackups" = "true" ] && [ $destIsRemote -eq 0 ] && \
+       [ "$doDryRun" != "true" ] && [ -d "$destFolder" ] ; then
+        phase catalog
+        build_catalog "$destFolder" "$linkDestFolder"
+    fi
 
+    phase cleanup
     if [ $destIsRemote -eq 0 ] ; then
         let maxBackupAge="$maxBackupAge * 24 * 60 * 60"
 
@@ -291,10 +1542,20 @@ else
             done
             IFS=$oldIfs
         fi
+    elif [ "$makeBackups" = "true" ] && [ $maxBackupAge -gt 0 ] && [ "$doDryRun" != "true" ] ; then
+        # Remove any old increments from remote destination
+        prune_remote_increments `expr $maxBackupAge \* 24 \* 60`
     fi
 
     # Remove lock
     rm "$fileName@CARBON_LOCK_EXTENSION@"
+    if [ "$hooksEnabled" = "true" ] && ( [ "$successCommand" != "" ] || [ "$failureCommand" != "" ] ) ; then
+        phase command
+    fi
+    run_post_hooks $rv
+    write_metrics $rv
+    record_run $rv
+    phase end
 
     notify $rv
 
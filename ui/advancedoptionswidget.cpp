@@ -0,0 +1,83 @@
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include "advancedoptionswidget.h"
+#include "session.h"
+
+AdvancedOptionsWidget::AdvancedOptionsWidget(QWidget *parent)
+    : QWidget(parent) {
+    setupUi(this);
+    largeFileProfile->insertItem(Session::LARGE_FILE_NONE, tr("None"));
+    largeFileProfile->insertItem(Session::LARGE_FILE_DELTA, tr("Databases (in-place delta)"));
+    largeFileProfile->insertItem(Session::LARGE_FILE_VM, tr("VM images (in-place delta, sparse)"));
+    largeFileProfile->insertItem(Session::LARGE_FILE_APPEND, tr("Growing files (append, verify)"));
+    largeFileProfile->insertItem(Session::LARGE_FILE_WHOLE, tr("Fast disks (whole file, preallocate)"));
+    connect(largeFileProfile, SIGNAL(currentIndexChanged(int)), SLOT(controlLargeFileWidgets()));
+    snapshot->insertItem(Session::SNAPSHOT_NONE, tr("None (live source)"));
+    snapshot->insertItem(Session::SNAPSHOT_AUTO, tr("Automatic"));
+    snapshot->insertItem(Session::SNAPSHOT_BTRFS, tr("Btrfs subvolume snapshot"));
+    snapshot->insertItem(Session::SNAPSHOT_LVM, tr("LVM snapshot"));
+    snapshot->insertItem(Session::SNAPSHOT_ZFS, tr("ZFS snapshot"));
+}
+
+void AdvancedOptionsWidget::set(const Session &session) {
+    largeFileProfile->setCurrentIndex(session.largeFileProfileType());
+    largeFileSize->setValue(session.largeFileMinSize());
+    largeFilePatterns->setText(session.largeFilePatternList());
+    controlLargeFileWidgets();
+    parallelShards->setValue(session.shards());
+    pauseOnBattery->setChecked(session.pauseOnBatteryFlag());
+    pauseLoad->setValue(session.pauseLoadLimit());
+    hashCatalog->setChecked(session.hashCatalogFlag());
+    metricsDir->setText(session.metricsFolder());
+    snapshot->setCurrentIndex(session.snapshotMode());
+    preCommand->setText(session.preSyncCommand());
+    preCommandHalt->setChecked(session.preSyncCommandHaltFlag());
+    successCommand->setText(session.successSyncCommand());
+    successCommandBackground->setChecked(session.successSyncCommandBackgroundFlag());
+    failureCommand->setText(session.failureSyncCommand());
+    commandTimeout->setValue(session.syncCommandTimeout());
+}
+
+void AdvancedOptionsWidget::get(Session &session) {
+    session.setLargeFileProfileType((Session::LargeFileProfile)largeFileProfile->currentIndex());
+    session.setLargeFileMinSize(largeFileSize->value());
+    session.setLargeFilePatternList(largeFilePatterns->text().simplified());
+    session.setShards(parallelShards->value());
+    session.setPauseOnBatteryFlag(pauseOnBattery->isChecked());
+    session.setPauseLoadLimit(pauseLoad->value());
+    session.setHashCatalogFlag(hashCatalog->isChecked());
+    session.setMetricsFolder(metricsDir->text().trimmed());
+    session.setSnapshotMode((Session::SnapshotMode)snapshot->currentIndex());
+    session.setPreSyncCommand(preCommand->text().trimmed());
+    session.setPreSyncCommandHaltFlag(preCommandHalt->isChecked());
+    session.setSuccessSyncCommand(successCommand->text().trimmed());
+    session.setSuccessSyncCommandBackgroundFlag(successCommandBackground->isChecked());
+    session.setFailureSyncCommand(failureCommand->text().trimmed());
+    session.setSyncCommandTimeout(commandTimeout->value());
+}
+
+void AdvancedOptionsWidget::controlLargeFileWidgets() {
+    bool enable = Session::LARGE_FILE_NONE != largeFileProfile->currentIndex();
+    largeFileSize->setEnabled(enable);
+    largeFilePatterns->setEnabled(enable);
+}
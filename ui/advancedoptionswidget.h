@@ -0,0 +1,43 @@
+#ifndef __ADVANCEDOPTIONS_WIDGET_H__
+#define __ADVANCEDOPTIONS_WIDGET_H__
+
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include "ui_advancedoptionswidget.h"
+
+class Session;
+
+class AdvancedOptionsWidget : public QWidget, Ui::AdvancedOptionsWidget {
+    Q_OBJECT
+
+public:
+    AdvancedOptionsWidget(QWidget *parent);
+
+    void set(const Session &session);
+    void get(Session &session);
+
+private Q_SLOTS:
+    void controlLargeFileWidgets();
+};
+
+#endif
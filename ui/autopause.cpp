@@ -0,0 +1,125 @@
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include "autopause.h"
+#include <QTimer>
+#include <QThread>
+#include <QFile>
+#include <QDir>
+
+static const int constCheckInterval = 5000;
+// Once paused due to load, only resume when it has dropped below this percentage of the limit - otherwise the
+// session's own load would cause it to keep pausing and resuming.
+static const int constResumeLoad = 80;
+
+static QString readSysFile(const QString &path) {
+    QFile f(path);
+    return f.open(QIODevice::ReadOnly) ? QString::fromLatin1(f.readAll()).trimmed() : QString();
+}
+
+AutoPause::AutoPause(QObject *parent)
+    : QObject(parent)
+    , timer(0)
+    , checkBattery(false)
+    , maxLoad(0)
+    , current(REASON_NONE) {
+}
+
+AutoPause::~AutoPause() {
+}
+
+void AutoPause::start(bool pauseOnBattery, int load) {
+    checkBattery = pauseOnBattery;
+    maxLoad = load;
+    current = REASON_NONE;
+    if (!checkBattery && maxLoad <= 0) {
+        stop();
+        return;
+    }
+    if (!timer) {
+        timer = new QTimer(this);
+        connect(timer, SIGNAL(timeout()), SLOT(check()));
+    }
+    timer->start(constCheckInterval);
+}
+
+void AutoPause::stop() {
+    if (timer) {
+        timer->stop();
+    }
+    current = REASON_NONE;
+}
+
+QString AutoPause::toString(Reason r) {
+    switch (r) {
+    case REASON_BATTERY:
+        return tr("Paused, as running on battery");
+    case REASON_LOAD:
+        return tr("Paused, as system load is high");
+    default:
+        return QString();
+    }
+}
+
+bool AutoPause::onBattery() {
+    static const QString constPowerSupplies = QLatin1String("/sys/class/power_supply/");
+    QStringList supplies = QDir(constPowerSupplies).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    bool haveBattery = false;
+
+    foreach (const QString &supply, supplies) {
+        QString type = readSysFile(constPowerSupplies + supply + QLatin1String("/type"));
+        if (QLatin1String("Mains") == type || QLatin1String("USB") == type) {
+            if (QLatin1String("1") == readSysFile(constPowerSupplies + supply + QLatin1String("/online"))) {
+                return false;
+            }
+        } else if (QLatin1String("Battery") == type &&
+                   QLatin1String("Device") != readSysFile(constPowerSupplies + supply + QLatin1String("/scope"))) {
+            // Ignore the batteries of mice, etc.
+            haveBattery = true;
+        }
+    }
+    return haveBattery;
+}
+
+int AutoPause::loadPercent() {
+    QString loadAvg = readSysFile(QLatin1String("/proc/loadavg"));
+    int cpus = qMax(1, QThread::idealThreadCount());
+    return loadAvg.isEmpty() ? 0 : (int)(loadAvg.section(QLatin1Char(' '), 0, 0).toDouble() * 100 / cpus);
+}
+
+void AutoPause::check() {
+    Reason reason = REASON_NONE;
+
+    if (checkBattery && onBattery()) {
+        reason = REASON_BATTERY;
+    } else if (maxLoad > 0) {
+        int load = loadPercent();
+        if (load > maxLoad || (REASON_LOAD == current && load > (maxLoad * constResumeLoad) / 100)) {
+            reason = REASON_LOAD;
+        }
+    }
+
+    if (reason != current) {
+        current = reason;
+        emit changed(current);
+    }
+}
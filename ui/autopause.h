@@ -0,0 +1,71 @@
+#ifndef __AUTO_PAUSE_H__
+#define __AUTO_PAUSE_H__
+
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include <QObject>
+#include <QString>
+
+class QTimer;
+
+// Polls the power supply, and system load, while a session runs - so that it can be paused whilst on battery, or
+// whilst the system is busy.
+class AutoPause : public QObject {
+    Q_OBJECT
+
+public:
+    enum Reason {
+        REASON_NONE,
+        REASON_BATTERY,
+        REASON_LOAD
+    };
+
+    AutoPause(QObject *parent = 0);
+    virtual ~AutoPause();
+
+    // maxLoad is the 1 minute load average, as a percentage of the number of CPUs. 0 to ignore load.
+    void start(bool pauseOnBattery, int maxLoad);
+    void stop();
+    // Why the session should be paused, or REASON_NONE if it need not be
+    Reason reason() const {
+        return current;
+    }
+    static QString toString(Reason r);
+
+    static bool onBattery();
+    static int loadPercent();
+
+Q_SIGNALS:
+    void changed(AutoPause::Reason reason);
+
+private Q_SLOTS:
+    void check();
+
+private:
+    QTimer *timer;
+    bool checkBattery;
+    int maxLoad;
+    Reason current;
+};
+
+#endif
@@ -0,0 +1,91 @@
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include "changeset.h"
+#include "storage.h"
+#include <QObject>
+#include <QFile>
+
+QString ChangeSet::typeStr(Type t) {
+    switch (t) {
+    case TYPE_NEW:        return QObject::tr("New");
+    case TYPE_MODIFIED:   return QObject::tr("Modified");
+    case TYPE_DELETED:    return QObject::tr("Deleted");
+    case TYPE_ATTRIBUTES: return QObject::tr("Attributes");
+    default:              return QString();
+    }
+}
+
+ChangeSet::ChangeSet() {
+    clear();
+}
+
+void ChangeSet::clear() {
+    items.clear();
+    for (int i = 0; i < TYPE_NUM_TYPES; ++i) {
+        counts[i] = 0;
+    }
+    totalBytes = 0;
+}
+
+// itemised is rsync's YXcstpoguax string, or '*deleting'
+bool ChangeSet::add(const QString &itemised, qint64 size, const QString &path) {
+    if (itemised.length() < 2 || path.isEmpty()) {
+        return false;
+    }
+
+    Entry e;
+    e.isDir = path.endsWith(QLatin1Char('/'));
+    e.size = e.isDir ? 0 : size;
+    e.path = path;
+    e.flags = itemised;
+
+    if (itemised.startsWith(QLatin1String("*deleting"))) {
+        e.type = TYPE_DELETED;
+        e.size = 0;
+    } else if (QLatin1Char('*') == itemised[0]) {
+        return false;  // Some other message
+    } else if (itemised.mid(2).startsWith(QLatin1Char('+'))) {
+        e.type = TYPE_NEW;
+    } else if (QLatin1Char('<') == itemised[0] || QLatin1Char('>') == itemised[0] ||
+               QLatin1Char('c') == itemised[0] || QLatin1Char('h') == itemised[0]) {
+        e.type = TYPE_MODIFIED;
+    } else {
+        e.type = TYPE_ATTRIBUTES;
+        e.size = 0;
+    }
+
+    counts[e.type]++;
+    totalBytes += e.size;
+    items.append(e);
+    return true;
+}
+
+// Save as a list suitable for rsync's --files-from
+bool ChangeSet::save(const QString &fileName) const {
+    QByteArray data;
+
+    foreach (const Entry &e, items) {
+        data += QFile::encodeName(e.path) + '\n';
+    }
+    return Storage::write(fileName, data);
+}
@@ -0,0 +1,79 @@
+#ifndef __CHANGE_SET_H__
+#define __CHANGE_SET_H__
+
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include <QString>
+#include <QList>
+
+// The itemised changes reported by a dry run, as parsed from rsync's %i output.
+class ChangeSet {
+public:
+    enum Type {
+        TYPE_NEW,
+        TYPE_MODIFIED,
+        TYPE_DELETED,
+        TYPE_ATTRIBUTES,
+
+        TYPE_NUM_TYPES
+    };
+
+    struct Entry {
+        Type type;
+        bool isDir;
+        qint64 size;
+        QString path;
+        QString flags;
+    };
+
+    static QString typeStr(Type t);
+
+    ChangeSet();
+
+    void clear();
+    bool add(const QString &itemised, qint64 size, const QString &path);
+    bool isEmpty() const {
+        return items.isEmpty();
+    }
+    const QList<Entry> & entries() const {
+        return items;
+    }
+    QList<Entry> & entries() {
+        return items;
+    }
+    int count(Type t) const {
+        return counts[t];
+    }
+    // Bytes to be transferred - i.e. the size of new and modified files
+    qint64 bytes() const {
+        return totalBytes;
+    }
+    bool save(const QString &fileName) const;
+
+private:
+    QList<Entry> items;
+    int counts[TYPE_NUM_TYPES];
+    qint64 totalBytes;
+};
+
+#endif
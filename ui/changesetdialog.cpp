@@ -0,0 +1,87 @@
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include "changesetdialog.h"
+#include "changesetmodel.h"
+#include "utils.h"
+#include <QTreeView>
+#include <QHeaderView>
+#include <QLabel>
+#include <QVBoxLayout>
+#include <QIcon>
+
+ChangeSetDialog::ChangeSetDialog(QWidget *parent)
+    : Dialog(parent) {
+    QWidget *mainWidget = new QWidget(this);
+    QVBoxLayout *layout = new QVBoxLayout(mainWidget);
+
+    view = new QTreeView(mainWidget);
+    // Only visible rows are created, so uniform heights keep large change sets fast
+    view->setUniformRowHeights(true);
+    view->setSortingEnabled(true);
+    view->setAlternatingRowColors(true);
+    view->setSelectionMode(QAbstractItemView::NoSelection);
+    totals = new QLabel(mainWidget);
+    totals->setWordWrap(true);
+    layout->setMargin(0);
+    layout->addWidget(view);
+    layout->addWidget(totals);
+    setMainWidget(mainWidget);
+    setCaption(tr("Changes"));
+}
+
+bool ChangeSetDialog::run(ChangeSetModel *model, bool canApply) {
+    view->setModel(model);
+    view->sortByColumn(ChangeSetModel::COL_PATH, Qt::AscendingOrder);
+    view->header()->setSectionResizeMode(ChangeSetModel::COL_PATH, QHeaderView::Stretch);
+    view->header()->setSectionResizeMode(ChangeSetModel::COL_CHANGE, QHeaderView::ResizeToContents);
+    view->header()->setSectionResizeMode(ChangeSetModel::COL_SIZE, QHeaderView::ResizeToContents);
+    view->header()->setStretchLastSection(false);
+    if (1 == model->rowCount()) {
+        view->expandAll();
+    }
+
+    totals->setText(tr("<b>Total:</b> %1 new, %2 modified, %3 deleted, %4 attribute changes. %5 to transfer.")
+                    .arg(model->count(ChangeSet::TYPE_NEW)).arg(model->count(ChangeSet::TYPE_MODIFIED))
+                    .arg(model->count(ChangeSet::TYPE_DELETED)).arg(model->count(ChangeSet::TYPE_ATTRIBUTES))
+                    .arg(Utils::formatByteSize(model->bytes())));
+
+    if (canApply) {
+        setButtons(User1 | Close);
+        setButtonText(User1, tr("Synchronise Changes"));
+        setButtonIcon(User1, QIcon::fromTheme("view-refresh"));
+        view->setToolTip(tr("'Synchronise Changes' will only transfer the entries listed here, without scanning the source again."));
+    } else {
+        setButtons(Close);
+        view->setToolTip(QString());
+    }
+    resize(800, 500);
+    return QDialog::Accepted == exec();
+}
+
+void ChangeSetDialog::slotButtonClicked(int btn) {
+    if (User1 == btn) {
+        accept();
+    } else {
+        Dialog::slotButtonClicked(btn);
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef __CHANGE_SET_DIALOG_H__
+#define __CHANGE_SET_DIALOG_H__
+
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include "dialog.h"
+
+class ChangeSetModel;
+class QTreeView;
+class QLabel;
+
+class ChangeSetDialog : public Dialog {
+    Q_OBJECT
+
+public:
+    ChangeSetDialog(QWidget *parent);
+    virtual ~ChangeSetDialog() { }
+
+    // Returns true if the user chose to synchronise just these changes
+    bool run(ChangeSetModel *model, bool canApply);
+
+private:
+    void slotButtonClicked(int btn);
+
+private:
+    QTreeView *view;
+    QLabel *totals;
+};
+
+#endif
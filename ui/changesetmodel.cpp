@@ -0,0 +1,193 @@
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include "changesetmodel.h"
+#include "utils.h"
+#include <algorithm>
+
+// Entries are children of their session, whose row (+1) is used as the internal id. Sessions have an id of 0.
+
+class EntryLessThan {
+public:
+    EntryLessThan(int c, Qt::SortOrder o)
+        : column(c)
+        , order(o) {
+    }
+
+    bool operator()(const ChangeSet::Entry &a, const ChangeSet::Entry &b) const {
+        return Qt::AscendingOrder == order ? lessThan(a, b) : lessThan(b, a);
+    }
+
+private:
+    bool lessThan(const ChangeSet::Entry &a, const ChangeSet::Entry &b) const {
+        switch (column) {
+        case ChangeSetModel::COL_CHANGE:
+            return a.type == b.type ? a.path < b.path : a.type < b.type;
+        case ChangeSetModel::COL_SIZE:
+            return a.size == b.size ? a.path < b.path : a.size < b.size;
+        default:
+            return a.path < b.path;
+        }
+    }
+
+private:
+    int column;
+    Qt::SortOrder order;
+};
+
+ChangeSetModel::ChangeSetModel(QObject *parent)
+    : QAbstractItemModel(parent) {
+}
+
+void ChangeSetModel::clear() {
+    beginResetModel();
+    sessions.clear();
+    endResetModel();
+}
+
+void ChangeSetModel::add(const QString &session, const ChangeSet &changes) {
+    beginInsertRows(QModelIndex(), sessions.count(), sessions.count());
+    Item item;
+    item.name = session;
+    item.changes = changes;
+    sessions.append(item);
+    endInsertRows();
+}
+
+int ChangeSetModel::count(ChangeSet::Type t) const {
+    int total = 0;
+    foreach (const Item &i, sessions) {
+        total += i.changes.count(t);
+    }
+    return total;
+}
+
+qint64 ChangeSetModel::bytes() const {
+    qint64 total = 0;
+    foreach (const Item &i, sessions) {
+        total += i.changes.bytes();
+    }
+    return total;
+}
+
+QModelIndex ChangeSetModel::index(int row, int column, const QModelIndex &parent) const {
+    if (row < 0 || column < 0 || column >= NUM_COLS) {
+        return QModelIndex();
+    }
+
+    if (!parent.isValid()) {
+        return row < sessions.count() ? createIndex(row, column, (quintptr)0) : QModelIndex();
+    }
+
+    if (0 == parent.internalId() && parent.row() < sessions.count() && row < sessions.at(parent.row()).changes.entries().count()) {
+        return createIndex(row, column, (quintptr)(parent.row() + 1));
+    }
+    return QModelIndex();
+}
+
+QModelIndex ChangeSetModel::parent(const QModelIndex &child) const {
+    if (!child.isValid() || 0 == child.internalId()) {
+        return QModelIndex();
+    }
+    return createIndex(child.internalId() - 1, 0, (quintptr)0);
+}
+
+int ChangeSetModel::rowCount(const QModelIndex &parent) const {
+    if (!parent.isValid()) {
+        return sessions.count();
+    }
+    if (0 == parent.internalId() && 0 == parent.column()) {
+        return sessions.at(parent.row()).changes.entries().count();
+    }
+    return 0;
+}
+
+int ChangeSetModel::columnCount(const QModelIndex &parent) const {
+    Q_UNUSED(parent)
+    return NUM_COLS;
+}
+
+QVariant ChangeSetModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid()) {
+        return QVariant();
+    }
+
+    if (Qt::TextAlignmentRole == role) {
+        return COL_SIZE == index.column() ? int(Qt::AlignRight | Qt::AlignVCenter) : int(Qt::AlignLeft | Qt::AlignVCenter);
+    }
+
+    if (Qt::DisplayRole != role && Qt::ToolTipRole != role) {
+        return QVariant();
+    }
+
+    if (0 == index.internalId()) {
+        const Item &i = sessions.at(index.row());
+        switch (index.column()) {
+        case COL_PATH:
+            return i.name;
+        case COL_CHANGE:
+            return tr("%1 new, %2 modified, %3 deleted, %4 attributes")
+                   .arg(i.changes.count(ChangeSet::TYPE_NEW)).arg(i.changes.count(ChangeSet::TYPE_MODIFIED))
+                   .arg(i.changes.count(ChangeSet::TYPE_DELETED)).arg(i.changes.count(ChangeSet::TYPE_ATTRIBUTES));
+        case COL_SIZE:
+            return Utils::formatByteSize(i.changes.bytes());
+        default:
+            return QVariant();
+        }
+    }
+
+    const ChangeSet::Entry &e = sessions.at(index.internalId() - 1).changes.entries().at(index.row());
+    switch (index.column()) {
+    case COL_PATH:
+        return e.path;
+    case COL_CHANGE:
+        return Qt::ToolTipRole == role ? e.flags : ChangeSet::typeStr(e.type);
+    case COL_SIZE:
+        return e.isDir || ChangeSet::TYPE_DELETED == e.type || ChangeSet::TYPE_ATTRIBUTES == e.type
+               ? QVariant()
+               : QVariant(Utils::formatByteSize(e.size));
+    default:
+        return QVariant();
+    }
+}
+
+QVariant ChangeSetModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (Qt::Horizontal != orientation || Qt::DisplayRole != role) {
+        return QVariant();
+    }
+
+    switch (section) {
+    case COL_PATH:   return tr("Path");
+    case COL_CHANGE: return tr("Change");
+    case COL_SIZE:   return tr("Size");
+    default:         return QVariant();
+    }
+}
+
+void ChangeSetModel::sort(int column, Qt::SortOrder order) {
+    beginResetModel();
+    for (int i = 0; i < sessions.count(); ++i) {
+        QList<ChangeSet::Entry> &entries = sessions[i].changes.entries();
+        std::stable_sort(entries.begin(), entries.end(), EntryLessThan(column, order));
+    }
+    endResetModel();
+}
@@ -0,0 +1,71 @@
+#ifndef __CHANGE_SET_MODEL_H__
+#define __CHANGE_SET_MODEL_H__
+
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include <QAbstractItemModel>
+#include <QList>
+#include "changeset.h"
+
+// Two level tree of session -> changes, as found by a dry run
+class ChangeSetModel : public QAbstractItemModel {
+    Q_OBJECT
+
+public:
+    enum Columns {
+        COL_PATH,
+        COL_CHANGE,
+        COL_SIZE,
+
+        NUM_COLS
+    };
+
+    ChangeSetModel(QObject *parent = 0);
+    virtual ~ChangeSetModel() { }
+
+    void clear();
+    void add(const QString &session, const ChangeSet &changes);
+    bool isEmpty() const {
+        return sessions.isEmpty();
+    }
+    int count(ChangeSet::Type t) const;
+    qint64 bytes() const;
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+    QModelIndex parent(const QModelIndex &child) const;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+
+private:
+    struct Item {
+        QString name;
+        ChangeSet changes;
+    };
+
+    QList<Item> sessions;
+};
+
+#endif
@@ -0,0 +1,909 @@
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include "commandline.h"
+#include "sessionrunner.h"
+#include "sourcewatcher.h"
+#include "sessionstore.h"
+#include "session.h"
+#include "utils.h"
+#include "config.h"
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QTimer>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QTextStream>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSocketNotifier>
+#include <string.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const char * constOptions[] = { "--run", "--dry-run", "--verify", "--watch", "--list", "--status", "--export", "--import",
+                                       "--help", 0 };
+
+static QTextStream & out() {
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+static QTextStream & err() {
+    static QTextStream stream(stderr);
+    return stream;
+}
+
+// Runners are in their own process groups, so do not see Ctrl+C. SIGINT/SIGTERM are passed to the event loop via
+// this socket pair, and the runners are then cancelled from there.
+static int signalFd[2] = { -1, -1 };
+
+static void signalHandler(int) {
+    char c = 1;
+    ssize_t r = ::write(signalFd[0], &c, sizeof(c));
+    Q_UNUSED(r)
+}
+
+static bool isRunning(const QString &lockFileName) {
+    QFile lock(lockFileName);
+
+    if (lock.open(QIODevice::ReadOnly)) {
+        bool ok;
+        int pid = QString(lock.readAll()).trimmed().toInt(&ok);
+        return ok && pid > 0 && 0 == ::kill(pid, 0);
+    }
+    return false;
+}
+
+static bool isRunning(const Session *s) {
+    return isRunning(s->lockFileName());
+}
+
+bool CommandLine::isCommandLine(int argc, char **argv) {
+    if (argc > 1) {
+        for (int i = 0; constOptions[i]; ++i) {
+            if (0 == strcmp(argv[1], constOptions[i])) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+CommandLine::CommandLine()
+    : mode(MODE_NONE)
+    , json(false)
+    , all(false)
+    , useChanges(false)
+    , jobs(1)
+    , maxAge(0)
+    , cancelling(false)
+    , running(0)
+    , failed(0)
+    , result(0)
+    , loop(0) {
+}
+
+CommandLine::~CommandLine() {
+    qDeleteAll(sessions);
+}
+
+int CommandLine::exec(const QStringList &args) {
+    if (!parse(args)) {
+        usage();
+        return 101;
+    }
+
+    switch (mode) {
+    case MODE_HELP:
+        usage();
+        return 0;
+    case MODE_LIST:
+        return loadSessions() ? list() : 102;
+    case MODE_STATUS:
+        return loadSessions() ? status() : 102;
+    case MODE_RUN:
+    case MODE_DRY_RUN:
+    case MODE_VERIFY:
+        return loadSessions() ? run() : 102;
+    case MODE_WATCH:
+        return loadSessions() ? watch() : 102;
+    case MODE_EXPORT:
+        return loadSessions() ? exportStore() : 102;
+    case MODE_IMPORT:
+        return importStore();
+    default:
+        return 101;
+    }
+}
+
+bool CommandLine::parse(const QStringList &args) {
+    for (int i = 1; i < args.count(); ++i) {
+        const QString &a = args.at(i);
+
+        if (QLatin1String("--run") == a || QLatin1String("--dry-run") == a || QLatin1String("--verify") == a ||
+            QLatin1String("--watch") == a || QLatin1String("--list") == a || QLatin1String("--status") == a ||
+            QLatin1String("--help") == a) {
+            if (MODE_NONE != mode) {
+                return false;
+            }
+            mode = QLatin1String("--run") == a
+                   ? MODE_RUN
+                   : QLatin1String("--dry-run") == a
+                     ? MODE_DRY_RUN
+                     : QLatin1String("--verify") == a
+                     ? MODE_VERIFY
+                     : QLatin1String("--watch") == a
+                     ? MODE_WATCH
+                     : QLatin1String("--list") == a
+                       ? MODE_LIST
+                       : QLatin1String("--status") == a
+                         ? MODE_STATUS
+                         : MODE_HELP;
+        } else if (QLatin1String("--export") == a || QLatin1String("--import") == a) {
+            if (MODE_NONE != mode || i + 1 >= args.count()) {
+                return false;
+            }
+            mode = QLatin1String("--export") == a ? MODE_EXPORT : MODE_IMPORT;
+            storeFile = args.at(++i);
+        } else if (QLatin1String("--json") == a) {
+            json = true;
+        } else if (QLatin1String("--all") == a) {
+            all = true;
+        } else if (QLatin1String("--changes") == a) {
+            useChanges = true;
+        } else if (QLatin1String("--max-age") == a) {
+            bool ok = false;
+            if (i + 1 < args.count()) {
+                maxAge = args.at(++i).toInt(&ok);
+            }
+            if (!ok || maxAge < 0) {
+                return false;
+            }
+        } else if (QLatin1String("--group") == a) {
+            if (i + 1 >= args.count()) {
+                return false;
+            }
+            groups.append(args.at(++i));
+        } else if (QLatin1String("--record") == a) {
+            if (i + 1 >= args.count()) {
+                return false;
+            }
+            recordDir = args.at(++i);
+        } else if (QLatin1String("-j") == a || QLatin1String("--jobs") == a) {
+            bool ok = false;
+            if (i + 1 < args.count()) {
+                jobs = args.at(++i).toInt(&ok);
+            }
+            if (!ok || jobs < 1) {
+                return false;
+            }
+        } else if (a.startsWith(QLatin1String("--jobs="))) {
+            bool ok;
+            jobs = a.mid(7).toInt(&ok);
+            if (!ok || jobs < 1) {
+                return false;
+            }
+        } else if (a.startsWith(QLatin1Char('-'))) {
+            return false;
+        } else {
+            names.append(a);
+        }
+    }
+
+    if ((MODE_RUN == mode || MODE_DRY_RUN == mode || MODE_VERIFY == mode || MODE_WATCH == mode) && names.isEmpty() &&
+        groups.isEmpty() && !all) {
+        return false;
+    }
+    return MODE_NONE != mode;
+}
+
+void CommandLine::usage() {
+    err() << tr("Usage: %1 --run|--dry-run [-j N] [--json] [--changes] [--record DIR] (--all | --group NAME | <session>...)\n"
+                "       %1 --verify [-j N] [--json] [--max-age DAYS] (--all | --group NAME | <session>...)\n"
+                "       %1 --watch [--json] (--all | --group NAME | <session>...)\n"
+                "       %1 --list [--json] [--group NAME]\n"
+                "       %1 --status [--json] [--group NAME] [<session>...]\n"
+                "       %1 --export FILE [--group NAME] [<session>...]\n"
+                "       %1 --import FILE [<session>...]\n"
+                "\n"
+                "  --run         Synchronise the named sessions.\n"
+                "  --dry-run     Perform a dry run of the named sessions.\n"
+                "  --verify      Verify the increments of the named backup sessions, against the\n"
+                "                file hashes catalogued when they were made.\n"
+                "  --max-age N   When verifying, only check files verified more than N days ago\n"
+                "                for changes, rather than reading them again.\n"
+                "  --watch       Synchronise the named sessions, then keep watching their sources,\n"
+                "                and synchronise the files that change within a few seconds,\n"
+                "                until interrupted. Only for local sources, and not backups.\n"
+                "  --list        List all sessions.\n"
+                "  --status      Show whether sessions are running, and when they last ran.\n"
+                "  --export FILE Add the named sessions (or all sessions), with their exclude\n"
+                "                patterns and history, to the session store FILE - replacing\n"
+                "                any of the same name.\n"
+                "  --import FILE Write the named sessions (or all sessions) in the session store\n"
+                "                FILE back to the sessions folder - replacing any of the same name.\n"
+                "  --all         Run all sessions.\n"
+                "  --group NAME  Run all sessions in the named group. May be repeated, and\n"
+                "                combined with session names.\n"
+                "  --changes     Only synchronise the changes found by the previous dry run,\n"
+                "                instead of scanning the source again. Not used for backups.\n"
+                "  --record DIR  Record each session's output to DIR/<session>.fixture, for\n"
+                "                replaying with 'carbon-bench --replay'.\n"
+                "  -j, --jobs N  Run up to N sessions in parallel (default 1).\n"
+                "  --json        Output one JSON object per line.\n"
+                "\n"
+                "Sessions are started after the sessions they are set to run after, and skipped if\n"
+                "any of those fail.\n"
+                "\n"
+                "The exit code is 0 if all sessions succeeded, otherwise the highest exit code of the\n"
+                "sessions that failed. It is 120 if the sessions' dependencies form a cycle, 121 if\n"
+                "the session store could not be read or written, and 122 if sessions to import are\n"
+                "not in the store, or are running.\n").arg(QCoreApplication::applicationName());
+    err().flush();
+}
+
+bool CommandLine::loadSessions() {
+    QFileInfoList files = QDir(Utils::dataDir(QString(), true)).entryInfoList(QStringList() << "*" CARBON_EXTENSION, QDir::NoDotAndDotDot | QDir::Files, QDir::Name);
+    QMap<QString, Session *> available;
+
+    foreach (const QFileInfo &f, files) {
+        Session *s = new Session(f.absoluteFilePath());
+        if (*s) {
+            available.insert(s->name(), s);
+        } else {
+            delete s;
+        }
+    }
+
+    if ((names.isEmpty() && groups.isEmpty()) || all) {
+        sessions = available.values();
+        return true;
+    }
+
+    bool ok = true;
+    foreach (const QString &group, groups) {
+        bool found = false;
+        foreach (Session *s, available) {
+            if (s->groupName() == group) {
+                found = true;
+                if (!sessions.contains(s)) {
+                    sessions.append(s);
+                }
+            }
+        }
+        if (!found) {
+            err() << tr("No sessions in group: %1").arg(group) << endl;
+            ok = false;
+        }
+    }
+
+    foreach (const QString &name, names) {
+        if (available.contains(name)) {
+            if (!sessions.contains(available[name])) {
+                sessions.append(available[name]);
+            }
+        } else {
+            err() << tr("Unknown session: %1").arg(name) << endl;
+            ok = false;
+        }
+    }
+
+    foreach (Session *s, available) {
+        if (!sessions.contains(s)) {
+            delete s;
+        }
+    }
+    return ok;
+}
+
+int CommandLine::list() {
+    QJsonArray array;
+
+    foreach (Session *s, sessions) {
+        if (json) {
+            QJsonObject obj;
+            obj["session"] = s->name();
+            obj["source"] = s->source();
+            obj["destination"] = s->destination();
+            obj["backup"] = s->makeBackupsFlag();
+            obj["group"] = s->groupName();
+            obj["dependsOn"] = QJsonArray::fromStringList(s->dependencies());
+            array.append(obj);
+        } else {
+            out() << s->name() << '\t' << s->source() << '\t' << s->destination() << '\t' << s->groupName() << endl;
+        }
+    }
+
+    if (json) {
+        out() << QJsonDocument(array).toJson(QJsonDocument::Compact) << endl;
+    }
+    return 0;
+}
+
+int CommandLine::status() {
+    QJsonArray array;
+    QHash<QString, SessionState> states = SessionState::readDir(Utils::dataDir());
+
+    foreach (Session *s, sessions) {
+        bool active = isRunning(s);
+        bool interrupted = !active && QFile::exists(s->checkpointFileName());
+        SessionState last = states.value(s->name());
+        if (last.isNull()) {
+            last.readLegacy(s->historyFileName(), s->logFileName());
+        }
+
+        if (json) {
+            QJsonObject obj;
+            obj["session"] = s->name();
+            obj["running"] = active;
+            obj["interrupted"] = interrupted;
+            obj["last"] = (qint64)last.time();
+            if (last.exitCode() >= 0) {
+                obj["exitCode"] = last.exitCode();
+            }
+            array.append(obj);
+        } else {
+            out() << s->name() << '\t' << (active ? tr("Running") : interrupted ? tr("Interrupted") : tr("Idle")) << '\t'
+                  << (last.isNull() ? tr("Never") : QDateTime::fromTime_t(last.time()).toString(Qt::SystemLocaleShortDate))
+                  << endl;
+        }
+    }
+
+    if (json) {
+        out() << QJsonDocument(array).toJson(QJsonDocument::Compact) << endl;
+    }
+    return 0;
+}
+
+int CommandLine::exportStore() {
+    SessionStore store(storeFile);
+    QString dir = Utils::dataDir(QString(), true);
+
+    if (!store.load()) {
+        err() << store.errorString() << endl;
+        return EXIT_STORE;
+    }
+
+    store.begin();
+    foreach (Session *s, sessions) {
+        if (!store.readSession(dir, s->name())) {
+            store.rollback();
+            err() << store.errorString() << endl;
+            return EXIT_STORE;
+        }
+    }
+    if (!store.commit()) {
+        err() << store.errorString() << endl;
+        return EXIT_STORE;
+    }
+
+    if (json) {
+        QJsonObject obj;
+        obj["event"] = QLatin1String("export");
+        obj["store"] = storeFile;
+        obj["sessions"] = sessions.count();
+        print(obj);
+    } else {
+        out() << tr("Exported %1 session(s) to %2").arg(sessions.count()).arg(storeFile) << endl;
+    }
+    return 0;
+}
+
+int CommandLine::importStore() {
+    SessionStore store(storeFile);
+    QString dir = Utils::dataDir(QString(), true);
+
+    if (!QFile::exists(storeFile)) {
+        err() << tr("No such session store: %1").arg(storeFile) << endl;
+        return EXIT_STORE;
+    }
+    if (!store.load()) {
+        err() << store.errorString() << endl;
+        return EXIT_STORE;
+    }
+
+    QStringList list = names.isEmpty() ? store.names() : names;
+    bool ok = true;
+    foreach (const QString &name, list) {
+        if (!store.find(name)) {
+            err() << tr("Unknown session: %1").arg(name) << endl;
+            ok = false;
+        } else if (isRunning(SessionStore::fileName(dir, name, SessionStore::FILE_SETTINGS) + QLatin1String(CARBON_LOCK_EXTENSION))) {
+            err() << tr("%1: Session is running").arg(name) << endl;
+            ok = false;
+        }
+    }
+    if (!ok) {
+        return EXIT_IMPORT;
+    }
+
+    if (store.writeDir(dir, list) < 0) {
+        err() << store.errorString() << endl;
+        return EXIT_STORE;
+    }
+
+    if (json) {
+        QJsonObject obj;
+        obj["event"] = QLatin1String("import");
+        obj["store"] = storeFile;
+        obj["sessions"] = list.count();
+        print(obj);
+    } else {
+        out() << tr("Imported %1 session(s) from %2").arg(list.count()).arg(storeFile) << endl;
+    }
+    return 0;
+}
+
+QSocketNotifier * CommandLine::catchSignals() {
+    QSocketNotifier *notifier = 0;
+
+    if (0 == ::socketpair(AF_UNIX, SOCK_STREAM, 0, signalFd)) {
+        notifier = new QSocketNotifier(signalFd[1], QSocketNotifier::Read, this);
+        connect(notifier, SIGNAL(activated(int)), this, SLOT(cancel()));
+
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = signalHandler;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESTART;
+        sigaction(SIGINT, &sa, 0);
+        sigaction(SIGTERM, &sa, 0);
+    }
+    return notifier;
+}
+
+void CommandLine::releaseSignals(QSocketNotifier *notifier) {
+    if (notifier) {
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        delete notifier;
+        ::close(signalFd[0]);
+        ::close(signalFd[1]);
+    }
+}
+
+int CommandLine::run() {
+    QEventLoop eventLoop;
+
+    if (!pipeline.set(sessions)) {
+        err() << pipeline.error() << endl;
+        return EXIT_CYCLE;
+    }
+
+    QSocketNotifier *notifier = catchSignals();
+    loop = &eventLoop;
+    QTimer::singleShot(0, this, SLOT(startNext()));
+    eventLoop.exec();
+    loop = 0;
+    releaseSignals(notifier);
+
+    if (json) {
+        QJsonObject obj;
+        obj["event"] = QLatin1String("summary");
+        obj["sessions"] = sessions.count();
+        obj["failed"] = failed;
+        obj["skipped"] = pipeline.count(SessionPipeline::STATE_SKIPPED);
+        obj["exitCode"] = result;
+        print(obj);
+    }
+    return result;
+}
+
+int CommandLine::watch() {
+    QEventLoop eventLoop;
+
+    foreach (Session *s, sessions) {
+        QString src = s->source();
+        if (src.startsWith(QLatin1String("file://"))) {
+            src = src.mid(7);
+        }
+        if (s->makeBackupsFlag()) {
+            err() << tr("%1: Backups can not be synchronised continuously").arg(s->name()) << endl;
+        } else if (src.contains(QLatin1Char(':')) || !QFileInfo(src).isDir()) {
+            err() << tr("%1: Only local source folders can be watched").arg(s->name()) << endl;
+        } else {
+            Watch w;
+            w.session = s;
+            w.watcher = new SourceWatcher(this);
+            if (!w.watcher->start(src)) {
+                err() << tr("%1: %2").arg(s->name()).arg(w.watcher->error()) << endl;
+            } else {
+                w.runner = createRunner(s);
+                connect(w.runner, SIGNAL(finished(int)), this, SLOT(watchFinished(int)));
+                connect(w.runner, SIGNAL(terminated()), this, SLOT(watchTerminated()));
+                connect(w.watcher, SIGNAL(changed()), this, SLOT(watchChanged()));
+                // Start with a full synchronisation, as changes made before the watch started are not known
+                w.watcher->setNeedsFullSync();
+                watches.append(w);
+                continue;
+            }
+        }
+        return 101;
+    }
+
+    QSocketNotifier *notifier = catchSignals();
+    loop = &eventLoop;
+    for (int i = 0; i < watches.count(); ++i) {
+        syncChanges(watches[i]);
+    }
+    eventLoop.exec();
+    loop = 0;
+    releaseSignals(notifier);
+    foreach (const Watch &w, watches) {
+        QFile::remove(w.session->watchFileName());
+    }
+    return 0;
+}
+
+void CommandLine::syncChanges(Watch &w) {
+    if (cancelling || w.runner->isRunning() || !w.watcher->hasChanges()) {
+        return;
+    }
+
+    bool full = w.watcher->needsFullSync();
+    QStringList paths = w.watcher->takeChanges();
+
+    if (!full) {
+        QFile list(w.session->watchFileName());
+        if (list.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            foreach (const QString &path, paths) {
+                list.write(QFile::encodeName(path));
+                list.write("\n", 1);
+            }
+        } else {
+            full = true;
+        }
+    }
+
+    if (json) {
+        QJsonObject obj;
+        obj["session"] = w.session->name();
+        obj["event"] = QLatin1String("start");
+        obj["full"] = full;
+        if (!full) {
+            obj["changes"] = paths.count();
+        }
+        print(obj);
+    } else {
+        print(w.session->name(), full ? tr("Synchronising all files") : tr("Synchronising %n changed path(s)", "", paths.count()));
+    }
+
+    running++;
+    if (full) {
+        w.runner->start(w.session, false);
+    } else {
+        w.runner->syncFiles(w.session, w.session->watchFileName());
+    }
+}
+
+CommandLine::Watch * CommandLine::findWatch(QObject *runnerOrWatcher) {
+    for (int i = 0; i < watches.count(); ++i) {
+        if (watches.at(i).runner == runnerOrWatcher || watches.at(i).watcher == runnerOrWatcher) {
+            return &watches[i];
+        }
+    }
+    return 0;
+}
+
+void CommandLine::watchChanged() {
+    Watch *w = findWatch(sender());
+
+    if (w) {
+        syncChanges(*w);
+    }
+}
+
+void CommandLine::watchFinished(int exitCode) {
+    Watch *w = findWatch(sender());
+
+    if (!w) {
+        return;
+    }
+
+    running--;
+    report(w->runner, exitCode);
+    lastProgress[w->runner] = -1;
+    if (cancelling) {
+        if (0 == running && loop) {
+            loop->quit();
+        }
+    } else if (0 == exitCode) {
+        // Sync what changed whilst this run was in progress
+        syncChanges(*w);
+    } else {
+        // Some changes may not have been applied, so the next run (once something else changes) must be complete.
+        // Not retrying straight away prevents a failing destination from being synchronised in a loop.
+        w->watcher->setNeedsFullSync();
+    }
+}
+
+void CommandLine::watchTerminated() {
+    // Report as rsync does, when interrupted
+    watchFinished(20);
+}
+
+void CommandLine::startNext() {
+    // Start as many sessions as the job limit, and their dependencies, allow
+    while (running < jobs) {
+        Session *s = pipeline.next();
+
+        if (!s) {
+            break;
+        }
+        start(s);
+    }
+
+    if (0 == running && loop) {
+        loop->quit();
+    }
+}
+
+// Create a runner whose progress is reported. The caller connects its finished(), and terminated(), signals.
+SessionRunner * CommandLine::createRunner(Session *s) {
+    SessionRunner *runner = new SessionRunner(this);
+
+    connect(runner, SIGNAL(pauseChanged(bool, QString)), this, SLOT(sessionPaused(bool, QString)));
+    connect(runner, SIGNAL(status(QString, bool)), this, SLOT(sessionStatus(QString, bool)));
+    connect(runner, SIGNAL(checking(int)), this, SLOT(sessionChecking(int)));
+    connect(runner, SIGNAL(sessionProgress(int)), this, SLOT(sessionProgress(int)));
+    connect(runner, SIGNAL(item(QString, qint64, QString)), this, SLOT(sessionItem()));
+    lastProgress[runner] = -1;
+    if (!recordDir.isEmpty() && QDir().mkpath(recordDir)) {
+        runner->setRecordFile(recordDir + QLatin1Char('/') + s->name() + QLatin1String(".fixture"));
+    }
+    return runner;
+}
+
+void CommandLine::start(Session *s) {
+    SessionRunner *runner = createRunner(s);
+
+    connect(runner, SIGNAL(finished(int)), this, SLOT(sessionFinished(int)));
+    connect(runner, SIGNAL(terminated()), this, SLOT(sessionTerminated()));
+    running++;
+
+    if (json) {
+        QJsonObject obj;
+        obj["session"] = s->name();
+        obj["event"] = QLatin1String("start");
+        obj["dryRun"] = MODE_DRY_RUN == mode;
+        obj["verify"] = MODE_VERIFY == mode;
+        print(obj);
+    } else {
+        print(s->name(), MODE_DRY_RUN == mode ? tr("Starting dry run") : MODE_VERIFY == mode ? tr("Starting verification") : tr("Starting"));
+    }
+    if (MODE_VERIFY == mode) {
+        runner->verify(s, maxAge);
+    } else {
+        runner->start(s, MODE_DRY_RUN == mode, useChanges);
+    }
+}
+
+void CommandLine::sessionFinished(int exitCode) {
+    SessionRunner *runner = qobject_cast<SessionRunner *>(sender());
+
+    if (!runner) {
+        return;
+    }
+
+    if (0 != exitCode) {
+        failed++;
+        if (exitCode > result) {
+            result = exitCode;
+        }
+    }
+    QList<Session *> skippedSessions = pipeline.finished(runner->session(), 0 == exitCode);
+
+    report(runner, exitCode);
+    skipped(skippedSessions);
+    lastProgress.remove(runner);
+    runner->deleteLater();
+    running--;
+    startNext();
+}
+
+void CommandLine::report(SessionRunner *runner, int exitCode) {
+    if (json) {
+        QJsonObject obj;
+        obj["session"] = runner->session()->name();
+        obj["event"] = QLatin1String("finished");
+        obj["exitCode"] = exitCode;
+        if (0 != exitCode) {
+            obj["error"] = SessionRunner::errorString(exitCode);
+        }
+        if (!runner->timing().isEmpty()) {
+            QJsonObject timing;
+            foreach (const RunTiming::Phase &p, runner->timing().phases()) {
+                timing[p.first] = p.second;
+            }
+            timing["total"] = runner->timing().total();
+            obj["timing"] = timing;
+        }
+        print(obj);
+    } else {
+        if (MODE_DRY_RUN == mode && 0 == exitCode) {
+            const ChangeSet &changes = runner->changes();
+            print(runner->session()->name(), tr("%1 new, %2 modified, %3 deleted, %4 attribute changes. %5 to transfer.")
+                  .arg(changes.count(ChangeSet::TYPE_NEW)).arg(changes.count(ChangeSet::TYPE_MODIFIED))
+                  .arg(changes.count(ChangeSet::TYPE_DELETED)).arg(changes.count(ChangeSet::TYPE_ATTRIBUTES))
+                  .arg(Utils::formatByteSize(changes.bytes())));
+        }
+        if (!runner->timing().isEmpty()) {
+            print(runner->session()->name(), tr("Time taken: %1").arg(runner->timing().toString()));
+        }
+        print(runner->session()->name(), 0 == exitCode ? tr("Finished") : tr("Failed: %1").arg(SessionRunner::errorString(exitCode)));
+    }
+}
+
+void CommandLine::sessionTerminated() {
+    // Report as rsync does, when interrupted
+    sessionFinished(20);
+}
+
+void CommandLine::sessionPaused(bool paused, const QString &reason) {
+    SessionRunner *runner = qobject_cast<SessionRunner *>(sender());
+
+    if (!runner) {
+        return;
+    }
+
+    if (json) {
+        QJsonObject obj;
+        obj["session"] = runner->session()->name();
+        obj["event"] = paused ? QLatin1String("paused") : QLatin1String("resumed");
+        if (!reason.isEmpty()) {
+            obj["reason"] = reason;
+        }
+        print(obj);
+    } else {
+        print(runner->session()->name(), paused ? (reason.isEmpty() ? tr("Paused") : reason) : tr("Resumed"));
+    }
+}
+
+void CommandLine::cancel() {
+    char c;
+    ssize_t r = ::read(signalFd[1], &c, sizeof(c));
+    Q_UNUSED(r)
+
+    pipeline.cancel();
+    cancelling = true;
+    foreach (const Watch &w, watches) {
+        w.watcher->stop();
+    }
+    foreach (SessionRunner *runner, lastProgress.keys()) {
+        if (runner->isRunning()) {
+            if (!json) {
+                print(runner->session()->name(), tr("Cancelling"));
+            }
+            runner->terminate();
+        }
+    }
+    if (MODE_WATCH == mode && 0 == running && loop) {
+        loop->quit();
+    }
+}
+
+void CommandLine::sessionStatus(const QString &str, bool isError) {
+    SessionRunner *runner = qobject_cast<SessionRunner *>(sender());
+
+    if (!runner) {
+        return;
+    }
+
+    if (json) {
+        QJsonObject obj;
+        obj["session"] = runner->session()->name();
+        obj["event"] = QLatin1String("status");
+        obj["message"] = str;
+        obj["error"] = isError;
+        print(obj);
+    } else {
+        print(runner->session()->name(), str);
+    }
+}
+
+void CommandLine::sessionChecking(int files) {
+    SessionRunner *runner = qobject_cast<SessionRunner *>(sender());
+
+    if (!runner || !json) {
+        return;
+    }
+
+    QJsonObject obj;
+    obj["session"] = runner->session()->name();
+    obj["event"] = QLatin1String("checking");
+    obj["files"] = files;
+    print(obj);
+}
+
+void CommandLine::sessionProgress(int progress) {
+    SessionRunner *runner = qobject_cast<SessionRunner *>(sender());
+
+    if (!runner) {
+        return;
+    }
+
+    // Only report whole percentages, and for plain text only every 10%
+    int percent = progress / 10;
+    int &last = lastProgress[runner];
+
+    if (percent == last || (!json && percent / 10 == last / 10 && last >= 0)) {
+        return;
+    }
+    last = percent;
+
+    if (json) {
+        QJsonObject obj;
+        obj["session"] = runner->session()->name();
+        obj["event"] = QLatin1String("progress");
+        obj["percent"] = percent;
+        print(obj);
+    } else {
+        print(runner->session()->name(), QString("%1%").arg(percent));
+    }
+}
+
+void CommandLine::sessionItem() {
+    SessionRunner *runner = qobject_cast<SessionRunner *>(sender());
+
+    if (!runner || !json || runner->changes().isEmpty()) {
+        return;
+    }
+
+    static const char * constTypes[ChangeSet::TYPE_NUM_TYPES] = { "new", "modified", "deleted", "attributes" };
+    const ChangeSet::Entry &e = runner->changes().entries().last();
+    QJsonObject obj;
+    obj["session"] = runner->session()->name();
+    obj["event"] = QLatin1String("item");
+    obj["type"] = QLatin1String(constTypes[e.type]);
+    obj["path"] = e.path;
+    obj["size"] = e.size;
+    obj["flags"] = e.flags;
+    print(obj);
+}
+
+void CommandLine::skipped(const QList<Session *> &list) {
+    foreach (Session *s, list) {
+        if (json) {
+            QJsonObject obj;
+            obj["session"] = s->name();
+            obj["event"] = QLatin1String("skipped");
+            obj["dependsOn"] = QJsonArray::fromStringList(s->dependencies());
+            print(obj);
+        } else {
+            print(s->name(), tr("Skipped, as a session it runs after failed"));
+        }
+    }
+}
+
+void CommandLine::print(const QString &session, const QString &str) {
+    out() << '[' << session << "] " << str << endl;
+}
+
+void CommandLine::print(const QJsonObject &obj) {
+    out() << QJsonDocument(obj).toJson(QJsonDocument::Compact) << endl;
+}
@@ -0,0 +1,135 @@
+#ifndef __COMMAND_LINE_H__
+#define __COMMAND_LINE_H__
+
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+#include <QObject>
+#include <QStringList>
+#include <QList>
+#include <QMap>
+#include "sessionpipeline.h"
+
+class Session;
+class SessionRunner;
+class SourceWatcher;
+class QSocketNotifier;
+class QEventLoop;
+class QJsonObject;
+
+// Headless front-end, used when carbon is started with one of --run, --dry-run, --verify, --watch, --list, --status,
+// --export, or --import. Only requires a QCoreApplication.
+class CommandLine : public QObject {
+    Q_OBJECT
+
+public:
+    enum Mode {
+        MODE_NONE,
+        MODE_RUN,
+        MODE_DRY_RUN,
+        MODE_VERIFY,
+        MODE_WATCH,
+        MODE_LIST,
+        MODE_STATUS,
+        MODE_EXPORT,
+        MODE_IMPORT,
+        MODE_HELP
+    };
+
+    // Exit codes of the command line itself. The runner's own codes are 101 - 117, and rsync's are below 100.
+    enum ExitCode {
+        EXIT_CYCLE = 120,  // The sessions' dependencies form a cycle
+        EXIT_STORE = 121,  // The session store could not be read, or written
+        EXIT_IMPORT = 122  // Sessions to import are not in the store, or are running
+    };
+
+    static bool isCommandLine(int argc, char **argv);
+
+    CommandLine();
+    virtual ~CommandLine();
+
+    int exec(const QStringList &args);
+
+private Q_SLOTS:
+    void startNext();
+    void sessionFinished(int exitCode);
+    void sessionTerminated();
+    void sessionPaused(bool paused, const QString &reason);
+    void cancel();
+    void sessionStatus(const QString &str, bool isError);
+    void sessionChecking(int files);
+    void sessionProgress(int progress);
+    void sessionItem();
+    void watchChanged();
+    void watchFinished(int exitCode);
+    void watchTerminated();
+
+private:
+    // A session being synchronised continuously
+    struct Watch {
+        Session *session;
+        SourceWatcher *watcher;
+        SessionRunner *runner;
+    };
+
+    bool parse(const QStringList &args);
+    void usage();
+    bool loadSessions();
+    int list();
+    int status();
+    int exportStore();
+    int importStore();
+    int run();
+    int watch();
+    QSocketNotifier * catchSignals();
+    void releaseSignals(QSocketNotifier *notifier);
+    SessionRunner * createRunner(Session *s);
+    void start(Session *s);
+    void report(SessionRunner *runner, int exitCode);
+    void syncChanges(Watch &w);
+    Watch * findWatch(QObject *runnerOrWatcher);
+    void print(const QString &session, const QString &str);
+    void print(const QJsonObject &obj);
+    void skipped(const QList<Session *> &list);
+
+private:
+    Mode mode;
+    bool json;
+    bool all;
+    bool useChanges;
+    int jobs;
+    int maxAge;
+    QStringList names;
+    QStringList groups;
+    QString recordDir;
+    QString storeFile;
+    QList<Session *> sessions;
+    SessionPipeline pipeline;
+    QList<Watch> watches;
+    bool cancelling;
+    QMap<SessionRunner *, int> lastProgress;
+    int running;
+    int failed;
+    int result;
+    QEventLoop *loop;
+};
+
+#endif
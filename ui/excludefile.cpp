@@ -20,15 +20,21 @@
 */
 
 #include "excludefile.h"
-#include <QTextStream>
+#include "storage.h"
 #include <QFile>
 #include <unistd.h>
+#include <errno.h>
 
 ExcludeFile::ExcludeFile(const QString &name)
     : fileName(name) {
     load();
 }
 
+ExcludeFile::ExcludeFile(const QString &name, const PatternList &patterns)
+    : fileName(name)
+    , patternList(patterns) {
+}
+
 void ExcludeFile::load() {
     QFile f(fileName);
 
@@ -58,21 +64,16 @@ bool ExcludeFile::save(const QString &n) {
         return rv;
     }
 
-    QFile f(name);
-
-    if (f.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QTextStream fs(&f);
+    QByteArray data;
 
-        foreach (const Pattern &p, patternList) {
-            if (!p.comment.isEmpty()) {
-                fs << "# " << p.comment << endl;
-            }
-            fs << p.value << endl;
+    foreach (const Pattern &p, patternList) {
+        if (!p.comment.isEmpty()) {
+            data += "# " + p.comment.toUtf8() + '\n';
         }
+        data += p.value.toUtf8() + '\n';
+    }
 
-        fs.flush();
-        f.close();
-
+    if (Storage::write(name, data)) {
         if (fileName != name) {
             erase();
         }
@@ -84,7 +85,7 @@ bool ExcludeFile::save(const QString &n) {
 }
 
 bool ExcludeFile::erase() {
-    return fileName.isEmpty() || !QFile::exists(fileName) || 0 ==::unlink(QFile::encodeName(fileName).constData());
+    return fileName.isEmpty() || 0 == ::unlink(QFile::encodeName(fileName).constData()) || ENOENT == errno;
 }
 
 QString ExcludeFile::Pattern::toStr() {
@@ -32,6 +32,9 @@ public:
             : value(v), comment(c) { }
 
         QString toStr();
+        bool operator==(const Pattern &o) const {
+            return value == o.value && comment == o.comment;
+        }
 
         QString value;
         QString comment;
@@ -40,6 +43,7 @@ public:
     typedef QList<Pattern> PatternList;
 
     ExcludeFile(const QString &name);
+    ExcludeFile(const QString &name, const PatternList &patterns);
 
     void load();
     bool save(const QString &n = QString());
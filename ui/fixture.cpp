@@ -0,0 +1,78 @@
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include "fixture.h"
+#include <QList>
+
+static const char * constHeader = "CARBON-FIXTURE 1\n";
+
+bool Fixture::load(const QString &fileName, QList<Chunk> &chunks) {
+    QFile f(fileName);
+
+    if (!f.open(QIODevice::ReadOnly) || f.readLine() != constHeader) {
+        return false;
+    }
+
+    while (!f.atEnd()) {
+        QList<QByteArray> parts = f.readLine().trimmed().split(' ');
+        if (parts.count() != 3 || (parts.at(1) != "O" && parts.at(1) != "E")) {
+            return false;
+        }
+
+        Chunk c;
+        bool timeOk, lenOk;
+        c.msecs = parts.at(0).toLongLong(&timeOk);
+        c.isError = parts.at(1) == "E";
+        int len = parts.at(2).toInt(&lenOk);
+        if (!timeOk || !lenOk || len < 0) {
+            return false;
+        }
+        c.data = f.read(len);
+        if (c.data.size() != len) {
+            return false;
+        }
+        chunks.append(c);
+    }
+    return true;
+}
+
+bool Fixture::startRecording(const QString &fileName) {
+    stopRecording();
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(constHeader);
+    timer.start();
+    return true;
+}
+
+void Fixture::record(bool isError, const QByteArray &data) {
+    if (file.isOpen()) {
+        file.write(QByteArray::number(timer.elapsed()) + (isError ? " E " : " O ") + QByteArray::number(data.size()) + '\n');
+        file.write(data);
+    }
+}
+
+void Fixture::stopRecording() {
+    file.close();
+}
@@ -0,0 +1,58 @@
+#ifndef __FIXTURE_H__
+#define __FIXTURE_H__
+
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include <QFile>
+#include <QList>
+#include <QByteArray>
+#include <QElapsedTimer>
+
+// Recorded output of carbon-runner, so that it can be replayed through OutputParser without running rsync.
+// The file starts with a header line, and then for each read there is a "<msecs> <O|E> <length>" line
+// followed by the data that was read.
+class Fixture {
+public:
+    struct Chunk {
+        qint64 msecs;
+        bool isError;
+        QByteArray data;
+    };
+
+    static bool load(const QString &fileName, QList<Chunk> &chunks);
+
+    Fixture() { }
+
+    bool startRecording(const QString &fileName);
+    void record(bool isError, const QByteArray &data);
+    void stopRecording();
+    bool isRecording() const {
+        return file.isOpen();
+    }
+
+private:
+    QFile file;
+    QElapsedTimer timer;
+};
+
+#endif
@@ -36,8 +36,12 @@ GeneralOptionsWidget::GeneralOptionsWidget(QWidget *parent, bool showName)
     connect(type, SIGNAL(activated(int)), SLOT(typeChanged(int)));
 }
 
-void GeneralOptionsWidget::set(const Session &session, bool edit) {
+// When editing several sessions at once, only the settings they can share may be changed
+void GeneralOptionsWidget::set(const Session &session, bool edit, bool bulk) {
     type->setEnabled(!edit);
+    nameEdit->setEnabled(!bulk);
+    srcPath->setEnabled(!bulk);
+    destPath->setEnabled(!bulk);
     nameEdit->setText(session.isDefault() ? QObject::tr("New Session") : session.name());
     srcPath->setText(Utils::convertDirForDisplay(session.source()));
     destPath->setText(Utils::convertDirForDisplay(session.destination()));
@@ -50,6 +54,8 @@ void GeneralOptionsWidget::set(const Session &session, bool edit) {
         maxDays->setValue(7);
         dontDeleteOld->setChecked(true);
     }
+    group->setText(session.groupName());
+    dependsOn->setText(session.dependencies().join(QLatin1String(", ")));
 }
 
 void GeneralOptionsWidget::get(Session &session) {
@@ -57,6 +63,8 @@ void GeneralOptionsWidget::get(Session &session) {
     session.setDestination(dest());
     session.setMakeBackupsFlag(type->currentIndex() ? true : false);
     session.setMaxBackupDays(deleteOld->isChecked() ? maxDays->value() : 0);
+    session.setGroupName(group->text().trimmed());
+    session.setDependencies(dependsOn->text().split(QLatin1Char(','), QString::SkipEmptyParts));
     session.setName(name());
 }
 
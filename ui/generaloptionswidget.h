@@ -44,7 +44,7 @@ public:
         return Utils::convertDirFromDisplay(destPath->text());
     }
 
-    void set(const Session &session, bool edit);
+    void set(const Session &session, bool edit, bool bulk = false);
     void get(Session &session);
 
 private Q_SLOTS:
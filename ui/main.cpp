@@ -22,6 +22,7 @@
 #include "utils.h"
 #include "mainwindow.h"
 #include "messagebox.h"
+#include "commandline.h"
 #include "config.h"
 #include <QApplication>
 #include <QIcon>
@@ -42,6 +43,18 @@ static QString fixArg(QString a, const QString &param) {
 }
 
 int main(int argc, char **argv) {
+    if (CommandLine::isCommandLine(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        QCoreApplication::setApplicationName(CARBON_PACKAGE_NAME);
+        QCoreApplication::setOrganizationName(CARBON_PACKAGE_NAME);
+
+        if (Utils::findExe("rsync").isEmpty()) {
+            std::cerr << QObject::tr("'rsync' could not be found on your system.").toLocal8Bit().constData() << std::endl;
+            return 1;
+        }
+        return CommandLine().exec(app.arguments());
+    }
+
     QApplication app(argc, argv);
 
     #ifdef QT_QTDBUS_FOUND
@@ -80,7 +80,12 @@ void MainWindow::setupActions() {
 
     editSessionAction = new QAction(QIcon::fromTheme("document-properties"), tr("Edit..."), this);
     connect(editSessionAction, SIGNAL(triggered(bool)), sessionWidget, SLOT(editSession()));
-    editSessionAction->setToolTip(tr("Change synchronisation session properties."));
+    editSessionAction->setToolTip(tr("Change synchronisation session properties. If several sessions are selected, the "
+                                     "settings that are changed are applied to all of them."));
+
+    cloneSessionAction = new QAction(QIcon::fromTheme("edit-copy"), tr("Clone..."), this);
+    connect(cloneSessionAction, SIGNAL(triggered(bool)), sessionWidget, SLOT(cloneSession()));
+    cloneSessionAction->setToolTip(tr("Create copies of the selected sessions, with new names, sources, and destinations."));
 
     deleteSessionAction = new QAction(QIcon::fromTheme("edit-delete"), tr("Delete..."), this);
     connect(deleteSessionAction, SIGNAL(triggered(bool)), sessionWidget, SLOT(removeSession()));
@@ -106,12 +111,14 @@ void MainWindow::setupActions() {
 
     deleteSessionAction->setEnabled(false);
     editSessionAction->setEnabled(false);
+    cloneSessionAction->setEnabled(false);
     showLogAction->setEnabled(false);
     dryRunAction->setEnabled(false);
     syncAction->setEnabled(false);
 
     connect(sessionWidget, SIGNAL(itemsSelected(bool)), deleteSessionAction, SLOT(setEnabled(bool)));
-    connect(sessionWidget, SIGNAL(singleItemSelected(bool)), editSessionAction, SLOT(setEnabled(bool)));
+    connect(sessionWidget, SIGNAL(itemsSelected(bool)), editSessionAction, SLOT(setEnabled(bool)));
+    connect(sessionWidget, SIGNAL(itemsSelected(bool)), cloneSessionAction, SLOT(setEnabled(bool)));
     connect(sessionWidget, SIGNAL(haveLog(bool)), showLogAction, SLOT(setEnabled(bool)));
     connect(sessionWidget, SIGNAL(haveSessions(bool)), dryRunAction, SLOT(setEnabled(bool)));
     connect(sessionWidget, SIGNAL(haveSessions(bool)), syncAction, SLOT(setEnabled(bool)));
@@ -120,6 +127,7 @@ void MainWindow::setupActions() {
     QMenu *menu = new QMenu(sessionWidget);
     menu->addAction(deleteSessionAction);
     menu->addAction(editSessionAction);
+    menu->addAction(cloneSessionAction);
     menu->addSeparator();
     menu->addAction(showLogAction);
     menu->addSeparator();
@@ -160,6 +168,7 @@ void MainWindow::restoreSession(bool on) {
     newSessionAction->setEnabled(!on);
     if (on) {
         editSessionAction->setEnabled(false);
+        cloneSessionAction->setEnabled(false);
         deleteSessionAction->setEnabled(false);
         showLogAction->setEnabled(false);
         dryRunAction->setEnabled(false);
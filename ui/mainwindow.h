@@ -49,6 +49,7 @@ private:
     QString rsync;
     QAction *newSessionAction;
     QAction *editSessionAction;
+    QAction *cloneSessionAction;
     QAction *deleteSessionAction;
     QAction *showLogAction;
     QAction *dryRunAction;
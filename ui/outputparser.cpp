@@ -0,0 +1,197 @@
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+#include "outputparser.h"
+#include "config.h"
+#include <QStringList>
+#include <QRegExp>
+#include <stdio.h>
+
+OutputParser::OutputParser(QObject *parent)
+    : QObject(parent)
+    , syncStatus(STARTUP)
+    , scanning(false) {
+}
+
+void OutputParser::reset() {
+    prevStout = QString();
+    syncStatus = STARTUP;
+    scanning = false;
+    shardProgress.clear();
+}
+
+void OutputParser::parse(const QByteArray &data) {
+    QString raw(prevStout + data);
+    QString str(raw.replace('\r', '\n'));
+    bool doLast(str.size() && '\n' == str[str.size() - 1]);
+    QStringList lines(str.split('\n', QString::SkipEmptyParts));
+    QStringList::Iterator it(lines.begin());
+    QStringList::Iterator end(lines.end());
+    int numLines(lines.count());
+
+    prevStout = QString();
+    for (int l = 1; it != end; ++it, ++l) {
+        if (l == numLines) {
+            if (doLast) {
+                processLine(*it);
+            } else {
+                prevStout = *it;
+            }
+        } else {
+            processLine(*it);
+        }
+    }
+}
+
+QString OutputParser::removePrefixes(const QString &str) {
+    static const QRegExp constShardPrefix(QLatin1String(CARBON_SHARD_PREFIX "\\d+:"));
+    static const QRegExp constPhase(QLatin1String(CARBON_PHASE_PREFIX "[^\n]*\n?"));
+    return QString(str).remove(constPhase).remove(constShardPrefix).replace(CARBON_ITEM_PREFIX, QString()).replace(CARBON_PREFIX, QString()).replace(CARBON_MSG_PREFIX, QString()).replace(CARBON_ERROR_PREFIX, QString());
+}
+
+void OutputParser::processLine(QString &line) {
+    // Lines from parallel shards are prefixed with SHARD:<n>:
+    int shard = -1;
+    if (0 == line.indexOf(CARBON_SHARD_PREFIX)) {
+        static const int constShardPrefixLen = sizeof(CARBON_SHARD_PREFIX) - 1;
+        int sep = line.indexOf(':', constShardPrefixLen);
+        if (-1 != sep) {
+            shard = line.mid(constShardPrefixLen, sep - constShardPrefixLen).toInt();
+            line = line.mid(sep + 1);
+        }
+    }
+
+    if (0 == line.indexOf(CARBON_PHASE_PREFIX)) {
+        // PHASE:<name> <msecs>
+        QStringList parts = line.mid(sizeof(CARBON_PHASE_PREFIX) - 1).split(' ', QString::SkipEmptyParts);
+        if (2 == parts.count()) {
+            scanning = QLatin1String("scan") == parts.at(0);
+            emit phase(parts.at(0), parts.at(1).toLongLong());
+        }
+        return;
+    }
+
+    if (0 == line.indexOf(CARBON_ITEM_PREFIX)) {
+        // ITEM:<itemised>|<size>|<path>
+        static const int constItemPrefixLen = sizeof(CARBON_ITEM_PREFIX) - 1;
+        int sizeSep = line.indexOf('|', constItemPrefixLen);
+        int pathSep = -1 == sizeSep ? -1 : line.indexOf('|', sizeSep + 1);
+
+        if (-1 != pathSep) {
+            QString path = line.mid(pathSep + 1);
+            checkTransferStarted();
+            syncStatus = SYNCING;
+            emit item(line.mid(constItemPrefixLen, sizeSep - constItemPrefixLen).trimmed(),
+                      line.mid(sizeSep + 1, pathSep - sizeSep - 1).toLongLong(), path);
+            emit status(path, false);
+        }
+        return;
+    }
+
+    bool isSynk(0 == line.indexOf(CARBON_PREFIX)),
+         isMsg(!isSynk && 0 == line.indexOf(CARBON_MSG_PREFIX)),
+         isError(!isSynk && !isMsg && 0 == line.indexOf(CARBON_ERROR_PREFIX));
+
+    if (isSynk) {
+        checkTransferStarted();
+        syncStatus = SYNCING;
+        line.replace(CARBON_PREFIX, QString());
+        emit status(line, false);
+        emit fileProgress(0);
+    } else if (isMsg) {
+        line.replace(CARBON_MSG_PREFIX, QString())
+        .replace("Cleaning old backups", tr("Cleaning old backups"))
+        .replace("Erasing", tr("Erasing"));
+
+        emit status(line, false);
+        syncStatus = SYNCING;
+    } else if (isError) {
+        line.replace(CARBON_ERROR_PREFIX, QString())
+        .replace("Cleaning old backups", tr("Cleaning old backups"))
+        .replace("Erasing", tr("Erasing"));
+
+        emit status(line, true);
+        syncStatus = SYNCING;
+    } else if (STARTUP == syncStatus && -1 != line.indexOf(" files...")) {
+        QStringList lst(line.split(' ', QString::SkipEmptyParts));
+
+        if (lst.size()) {
+            bool ok;
+            int  total(lst[0].toInt(&ok));
+
+            if (ok) {
+                emit checking(total);
+            }
+        }
+    } else if (-1 != line.indexOf("%")) {
+        QStringList lst(line.split(' ', QString::SkipEmptyParts));
+
+        if (lst.size() > 2) {
+            int percent;
+
+            if (1 == sscanf(lst[1].toLatin1().constData(), "%d%%", &percent)) {
+                checkTransferStarted();
+                emit fileProgress(percent);
+                syncStatus = SYNCING;
+            }
+            // rsync 3.1 shortened to-check= to to-chk=
+            static const QString constGlobalCheck = QLatin1String("to-check=");
+            static const QString constGlobalChk = QLatin1String("to-chk=");
+            foreach (const QString &str, lst) {
+                int len = str.startsWith(constGlobalCheck)
+                          ? constGlobalCheck.length()
+                          : str.startsWith(constGlobalChk)
+                            ? constGlobalChk.length()
+                            : 0;
+                if (len) {
+                    lst = str.mid(len).split('/');
+                    if (lst.size() >= 2) {
+                        QString totStr = lst.at(1);
+                        totStr = totStr.left(totStr.length() - 1);
+                        int total = totStr.toInt();
+                        int left = lst.at(0).toInt();
+
+                        if (total > 0 && left <= total) {
+                            if (shard >= 0) {
+                                // Overall progress is that of all shards combined
+                                shardProgress[shard] = qMakePair(left, total);
+                                left = total = 0;
+                                foreach (const QPair<int, int> &p, shardProgress) {
+                                    left += p.first;
+                                    total += p.second;
+                                }
+                            }
+                            emit sessionProgress(0 == left ? 1000 : (int)((((total - left) * 1000.0) / total) + 0.5));
+                        }
+                    }
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void OutputParser::checkTransferStarted() {
+    if (scanning) {
+        scanning = false;
+        emit phase(QLatin1String("transfer"), -1);
+    }
+}
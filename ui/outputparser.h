@@ -0,0 +1,72 @@
+#ifndef __OUTPUT_PARSER_H__
+#define __OUTPUT_PARSER_H__
+
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+#include <QObject>
+#include <QString>
+#include <QMap>
+#include <QPair>
+
+// Parses the output of carbon-runner, and emits the status and progress of the session.
+// Used by both the GUI, and the command-line front-end.
+class OutputParser : public QObject {
+    Q_OBJECT
+
+public:
+    enum EStatus {
+        STARTUP,
+        SYNCING
+    };
+
+    OutputParser(QObject *parent = 0);
+    virtual ~OutputParser() { }
+
+    void reset();
+    void parse(const QByteArray &data);
+
+    static QString removePrefixes(const QString &str);
+
+Q_SIGNALS:
+    void status(const QString &str, bool isError);
+    void checking(int files);
+    void fileProgress(int percent);
+    // Progress of whole session, 0..1000
+    void sessionProgress(int progress);
+    // Dry runs report each change - itemised is rsync's %i string
+    void item(const QString &itemised, qint64 size, const QString &path);
+    // Start of a phase of the run. msecs is the runner's timestamp, or -1 for the 'transfer' phase, which is
+    // detected here when rsync starts reporting files.
+    void phase(const QString &name, qint64 msecs);
+
+private:
+    void processLine(QString &line);
+    void checkTransferStarted();
+
+private:
+    QString prevStout;
+    EStatus syncStatus;
+    bool scanning;
+    QMap<int, QPair<int, int> > shardProgress; // shard -> files left, total
+};
+
+#endif
@@ -28,6 +28,9 @@
 RSyncOptionsWidget::RSyncOptionsWidget(QWidget *parent)
     : QWidget(parent) {
     setupUi(this);
+    useCompression->insertItem(Session::COMPRESS_NONE, tr("Off"));
+    useCompression->insertItem(Session::COMPRESS_ALWAYS, tr("On"));
+    useCompression->insertItem(Session::COMPRESS_AUTO, tr("Automatic"));
 
     //    if (0!=getuid()) {
     //        preserveSpecialFiles->setEnabled(false);
@@ -50,7 +53,7 @@ void RSyncOptionsWidget::set(const Session &session) {
     skipReceiverNewerFiles->setChecked(session.skipReceiverNewerFilesFlag());
     keepPartial->setChecked(session.keepPartialFlag());
     onlyUpdate->setChecked(session.onlyUpdateFlag());
-    useCompression->setChecked(session.useCompressionFlag());
+    useCompression->setCurrentIndex(session.compressionMode());
     checksum->setChecked(session.checksumFlag());
     windowsCompatability->setChecked(session.windowsFlag());
     ignoreExisting->setChecked(session.ignoreExistingFlag());
@@ -72,7 +75,7 @@ void RSyncOptionsWidget::get(Session &session) {
     session.setSkipReceiverNewerFilesFlag(skipReceiverNewerFiles->isChecked());
     session.setKeepPartialFlag(keepPartial->isChecked());
     session.setOnlyUpdateFlag(onlyUpdate->isChecked());
-    session.setUseCompressionFlag(useCompression->isChecked());
+    session.setCompressionMode((Session::Compression)useCompression->currentIndex());
     session.setChecksumFlag(checksum->isChecked());
     session.setWindowsFlag(windowsCompatability->isChecked());
     session.setIgnoreExistingFlag(ignoreExisting->isChecked());
@@ -20,106 +20,33 @@
 */
 
 #include "runnerdialog.h"
+#include "sessionrunner.h"
+#include "changesetmodel.h"
+#include "changesetdialog.h"
 #include "session.h"
-#include "utils.h"
 #include "messagebox.h"
-#include <QProcess>
+#include "utils.h"
 #include <QTimer>
-#include <QTextStream>
+#include <QTreeWidget>
+#include <QHeaderView>
 #ifdef QT_QTDBUS_FOUND
 #include <QDBusConnection>
 #include <unistd.h>
 #include <sys/types.h>
 #endif
 
-static inline QString removePrefixes(const QString &str) {
-    return QString(str).replace(CARBON_PREFIX, QString()).replace(CARBON_MSG_PREFIX, QString()).replace(CARBON_ERROR_PREFIX, QString());
-}
-
 static QString updatedFiles(int v) {
     return 0 == v ? QObject::tr("Checking for updated files...") : QObject::tr("Checking for updated files...%1").arg(v);
 }
 
-static QString toStr(int exitCode) {
-    switch (exitCode) {
-    case 101:
-        return QObject::tr("Usage error.");
-    case 102:
-        return QObject::tr("Could not read session file.");
-    case 103:
-        return QObject::tr("Destination folder does not exist, and could not be created.");
-    case 104:
-        return QObject::tr("Destination exists as a file.");
-    case 105:
-        return QObject::tr("Failed to mount destination folder.");
-    case 106:
-        return QObject::tr("Failed to unmount destination folder.");
-    case 107:
-        return QObject::tr("Mountpoint already exists.");
-    case 108:
-        return QObject::tr("Destination requires user@host");
-    case 109:
-        return QObject::tr("No source supplied.");
-    case 110:
-        return QObject::tr("No destination supplied.");
-    case 111:
-        return QObject::tr("Destination parent folder does not exist.");
-    case 112:
-        return QObject::tr("Source does not exist.");
-    case 113:
-        return QObject::tr("Session is already running.");
-    case 1:
-        return QObject::tr("Syntax or usage error.");
-    case 2:
-        return QObject::tr("Protocol incompatibility.");
-    case 3:
-        return QObject::tr("Errors selecting input/output files/folders.");
-    case 4:
-        return QObject::tr("Requested action not supported: an attempt "
-                           "was made to manipulate 64-bit files on a "
-                           "platform that cannot support them; or an "
-                           "option was specified that is supported by "
-                           "the client and not by the server.");
-    case 5:
-        return QObject::tr("Error starting client-server protocol.");
-    case 6:
-        return QObject::tr("Daemon unable to append to log-file.");
-    case 10:
-        return QObject::tr("Error in socket I/O.");
-    case 11:
-        return QObject::tr("Error in file I/O.");
-    case 12:
-        return QObject::tr("Error in rsync protocol data stream.");
-    case 13:
-        return QObject::tr("Errors with program diagnostics.");
-    case 14:
-        return QObject::tr("Error in IPC code.");
-    case 20:
-        return QObject::tr("Received SIGUSR1 or SIGINT.");
-    case 21:
-        return QObject::tr("Some error returned by waitpid().");
-    case 22:
-        return QObject::tr("Error allocating core memory buffers.");
-    case 23:
-        return QObject::tr("Partial transfer due to error.");
-    case 24:
-        return QObject::tr("Partial transfer due to vanished source files.");
-    case 25:
-        return QObject::tr("The --max-delete limit stopped deletions.");
-    case 30:
-        return QObject::tr("Timeout in data send/receive.");
-    case 35:
-        return QObject::tr("Timeout waiting for daemon connection.");
-    default:
-        return QObject::tr("Unknown error code %1.").arg(exitCode);
-    }
-
-    return QString();
-}
-
 RunnerDialog::RunnerDialog(QWidget *parent)
     : Dialog(parent)
-    , process(0) {
+    , currentSession(0)
+    , stopping(false)
+    , runner(new SessionRunner(this))
+    , changes(new ChangeSetModel(this))
+    , changesDialog(0)
+    , pauseTimer(new QTimer(this)) {
     QWidget *mainWidget = new QWidget(this);
 
     setupUi(mainWidget);
@@ -127,20 +54,35 @@ RunnerDialog::RunnerDialog(QWidget *parent)
     setButtons(Cancel);
     output->setReadOnly(true);
     output->setVisible(false);
+    pipelineView->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    pipelineView->header()->setSectionResizeMode(1, QHeaderView::ResizeToContents);
     setMinimumWidth(500);
     connect(detailsButton, SIGNAL(toggled(bool)), this, SLOT(showDetails(bool)));
+    connect(runner, SIGNAL(finished(int)), this, SLOT(processFinished(int)));
+    connect(runner, SIGNAL(status(QString, bool)), this, SLOT(setStatus(QString, bool)));
+    connect(runner, SIGNAL(checking(int)), this, SLOT(setChecking(int)));
+    connect(runner, SIGNAL(fileProgress(int)), fileProgress, SLOT(setValue(int)));
+    connect(runner, SIGNAL(sessionProgress(int)), this, SLOT(setSessionProgress(int)));
+    connect(runner, SIGNAL(output(QString)), this, SLOT(appendOutput(QString)));
+    connect(runner, SIGNAL(errorOutput(QString)), this, SLOT(appendError(QString)));
+    connect(runner, SIGNAL(pauseChanged(bool, QString)), this, SLOT(setPaused(bool, QString)));
+    connect(pauseTimer, SIGNAL(timeout()), this, SLOT(updatePaused()));
     #ifdef QT_QTDBUS_FOUND
     unityMessage = QDBusMessage::createSignal("/Carbon", "com.canonical.Unity.LauncherEntry", "Update");
     #endif
 }
 
 RunnerDialog::~RunnerDialog() {
-    disconnectProcess();
 }
 
-void RunnerDialog::go(const QList<Session *> &sessions, bool dry) {
+void RunnerDialog::go(const QList<Session *> &sessions, bool dry, bool useChanges) {
     setWindowTitle(dry ? tr("Performing Dry-Run") : tr("Performing Synchronisation"));
 
+    if (!pipeline.set(sessions)) {
+        MessageBox::error(parentWidget(), pipeline.error());
+        return;
+    }
+
     completedSessions = 0;
     overallProgress->setVisible(sessions.count() > 1);
     overallProgressLabel->setVisible(sessions.count() > 1);
@@ -153,128 +95,124 @@ void RunnerDialog::go(const QList<Session *> &sessions, bool dry) {
     sessionProgress->setMaximum(0);
     detailsButton->setChecked(false);
     dryRun = dry;
+    useChangeSets = useChanges;
+    canApplyChanges = applyChanges = false;
+    changes->clear();
 
-    stdErr = prevStout = QString();
     output->setText(QString());
-    currentSession = sessions.begin();
-    endSession = sessions.end();
-    sessionCount = sessions.count();
-    if (!process) {
-        process = new QProcess(this);
-        QStringList env(QProcess::systemEnvironment());
-        env.append(CARBON_GUI_PARENT"=true");
-        process->setEnvironment(env);
-        connect(process, SIGNAL(finished(int)), this, SLOT(processFinished(int)));
-        connect(process, SIGNAL(readyReadStandardOutput()), this, SLOT(readStdOut()));
-        connect(process, SIGNAL(readyReadStandardError()), this, SLOT(readStdErr()));
+    pipelineView->clear();
+    foreach (Session *s, pipeline.sessions()) {
+        new QTreeWidgetItem(pipelineView, QStringList() << s->name() << QString());
     }
-    setButtons(Cancel);
+    pipelineView->setVisible(sessions.count() > 1);
+    updatePipeline();
+    currentSession = 0;
+    stopping = false;
+    sessionCount = sessions.count();
+    setButtons(User2 | Cancel);
+    setButtonText(User2, tr("Pause"));
     QTimer::singleShot(0, this, SLOT(doNext()));
     QTimer::singleShot(0, this, SLOT(showDetails()));
     exec();
 }
 
+// Sessions are run one at a time, as there is only one set of progress bars, in the pipeline's order
 void RunnerDialog::doNext() {
-    syncStatus = STARTUP;
-    if (currentSession != endSession) {
-        sessionLabel->setText((*currentSession)->name());
-
-        QStringList arguments;
-
-        (*currentSession)->save();
-        arguments << (*currentSession)->fileName();
-
-        if (dryRun) {
-            arguments << "-d";
-        }
-
-        stdErr = QString();
-        prevStout = QString();
+    currentSession = stopping ? 0 : pipeline.next();
+    updatePipeline();
+    if (currentSession) {
+        sessionLabel->setText(currentSession->name());
         sessionProgress->setValue(0);
         sessionProgress->setMaximum(0);
         updateUnity(false);
         status->setText(updatedFiles(0));
         fileProgress->setValue(0);
-        logFile.close();
-        logFile.setFileName((*currentSession)->fileName() + CARBON_LOG_EXTENSION);
-        logFile.open(QIODevice::WriteOnly);
-        process->start(CARBON_RUNNER, arguments, QIODevice::ReadOnly);
+        runner->start(currentSession, dryRun, useChangeSets);
     } else {
+        pauseTimer->stop();
         fileProgress->setValue(fileProgress->maximum());
-        setButtons(Close);
+        if (dryRun && !changes->isEmpty()) {
+            setButtons(User1 | Close);
+            setButtonText(User1, tr("Show Changes..."));
+        } else {
+            setButtons(Close);
+        }
     }
 }
 
 void RunnerDialog::processFinished(int exitCode) {
-    logFile.close();
-
+    pauseTimer->stop();
+    setButtonText(User2, tr("Pause"));
+    if (!runner->timing().isEmpty()) {
+        appendOutput(QLatin1String("<i>") + tr("Time taken: %1").arg(runner->timing().toString()) + QLatin1String("</i>"));
+    }
+    QList<Session *> skipped = pipeline.finished(currentSession, 0 == exitCode);
+    updatePipeline();
     if (0 != exitCode) {
-        QString errorMsg = tr("<p>The <i>rsync</i> backend returned the following error:</p><p><i>%1</i></p>").arg(toStr(exitCode));
+        QString errorMsg = tr("<p>The <i>rsync</i> backend returned the following error:</p><p><i>%1</i></p>").arg(SessionRunner::errorString(exitCode));
         status->setText(tr("An error ocurred"));
-        if (currentSession == endSession) {
+        if (!skipped.isEmpty()) {
+            QStringList names;
+            foreach (Session *s, skipped) {
+                names.append(s->name());
+            }
+            errorMsg += tr("<p>The following sessions run after this one, and so will be skipped: %1</p>").arg(names.join(QLatin1String(", ")));
+        }
+        if (stopping) {
             MessageBox::error(this, errorMsg);
             return;
+        } else if (0 == pipeline.count(SessionPipeline::STATE_WAITING)) {
+            MessageBox::error(this, errorMsg);
         } else if (QMessageBox::No == MessageBox::warningYesNo(this, errorMsg + "<p>" + tr("Continue with next session?") + "</p>")) {
             return;
         }
     }
 
-    completedSessions++;
+    if (dryRun && 0 == exitCode && !runner->changes().isEmpty()) {
+        changes->add(currentSession->name(), runner->changes());
+        if (!currentSession->makeBackupsFlag()) {
+            canApplyChanges = true;
+        }
+    }
+
+    completedSessions += 1 + skipped.count();
     sessionProgress->setMaximum(1000);
     sessionProgress->setValue(sessionProgress->maximum());
     overallProgress->setValue(completedSessions * 1000);
-    updateUnity(currentSession == endSession);
-    if (currentSession == endSession) {
+    updateUnity(stopping);
+    if (stopping) {
         status->setText(tr("Cancelled"));
     } else {
         if (0 == exitCode) {
             status->setText(tr("Finished"));
         }
-        currentSession++;
         doNext();
     }
 }
 
-void RunnerDialog::readStdOut() {
-    if (!process) {
-        return;
-    }
-
-    QByteArray all(process->readAllStandardOutput());
-    QString raw(prevStout + all);
-    QString str(raw.replace('\r', '\n'));
-    bool doLast(str.size() && '\n' == str[str.size() - 1]);
-    QStringList lines(str.split('\n', QString::SkipEmptyParts));
-    QStringList::Iterator it(lines.begin());
-    QStringList::Iterator end(lines.end());
-    int numLines(lines.count());
+void RunnerDialog::setStatus(const QString &str, bool isError) {
+    status->setText(isError ? QString("<b>") + str + QString("</b>") : str);
+}
 
-    for (int l = 1; it != end; ++it, ++l) {
-        if (l == numLines) {
-            if (doLast) {
-                processLine(*it);
-            } else {
-                prevStout = *it;
-            }
-        } else {
-            processLine(*it);
-        }
-    }
-    str = removePrefixes(all);
-    output->append(str);
-    QTextStream(&logFile) << str;
+void RunnerDialog::setChecking(int files) {
+    status->setText(updatedFiles(files));
 }
 
-void RunnerDialog::readStdErr() {
-    if (!process) {
-        return;
+void RunnerDialog::setSessionProgress(int progress) {
+    if (0 == sessionProgress->maximum()) {
+        sessionProgress->setMaximum(1000);
     }
+    sessionProgress->setValue(progress);
+    overallProgress->setValue((1000 * completedSessions) + (sessionProgress->value()));
+    updateUnity(false);
+}
 
-    QString str(removePrefixes(process->readAllStandardError()));
+void RunnerDialog::appendOutput(const QString &str) {
+    output->append(str);
+}
 
-    stdErr += str;
+void RunnerDialog::appendError(const QString &str) {
     output->append("<b>" + str + "</b>");
-    QTextStream(&logFile) << str;
 }
 
 void RunnerDialog::showDetails(bool show) {
@@ -292,130 +230,63 @@ void RunnerDialog::showDetails(bool show) {
     }
 }
 
-void RunnerDialog::processLine(QString &line) {
-    bool isSynk(0 == line.indexOf(CARBON_PREFIX)),
-         isMsg(!isSynk && 0 == line.indexOf(CARBON_MSG_PREFIX)),
-         isError(!isSynk && !isMsg && 0 == line.indexOf(CARBON_ERROR_PREFIX));
-
-    if (isSynk) {
-        syncStatus = SYNCING;
-        line.replace(CARBON_PREFIX, QString());
-        status->setText(line);
-        fileProgress->setValue(0);
-    } else if (isMsg) {
-        line.replace(CARBON_MSG_PREFIX, QString())
-        .replace("Cleaning old backups", tr("Cleaning old backups"))
-        .replace("Erasing", tr("Erasing"));
-
-        status->setText(line);
-        syncStatus = SYNCING;
-    } else if (isError) {
-        line.replace(CARBON_ERROR_PREFIX, QString())
-        .replace("Cleaning old backups", tr("Cleaning old backups"))
-        .replace("Erasing", tr("Erasing"));
-
-        status->setText(QString("<b>") + line + QString("</b>"));
-        syncStatus = SYNCING;
-    } /*else if (STARTUP==syncStatus && -1!=line.indexOf("files to consider")) {
-        QStringList lst(line.split(' ', QString::SkipEmptyParts));
-
-        if (lst.size())
-        {
-            bool ok;
-            int total(lst[0].toInt(&ok));
-
-            if (ok)
-            {
-                sessionProgress->setMaximum(total);
-                syncStatus=SYNCING;
-            }
-        }
-    }*/ else if (STARTUP == syncStatus && -1 != line.indexOf(" files...")) {
-        QStringList lst(line.split(' ', QString::SkipEmptyParts));
-
-        if (lst.size()) {
-            bool ok;
-            int  total(lst[0].toInt(&ok));
-
-            if (ok) {
-                status->setText(updatedFiles(total));
-            }
-        }
-    } else if (-1 != line.indexOf("%")) {
-        QStringList lst(line.split(' ', QString::SkipEmptyParts));
-
-        if (lst.size() > 2) {
-            int percent;
-
-            if (1 == sscanf(lst[1].toLatin1().constData(), "%d%%", &percent)) {
-                fileProgress->setValue(percent);
-                syncStatus = SYNCING;
-            }
-            static const QString constGlobalCheck = QLatin1String("to-check=");
-            foreach (const QString &str, lst) {
-                if (str.startsWith(constGlobalCheck)) {
-                    lst = str.mid(constGlobalCheck.length()).split('/');
-                    if (lst.size() >= 2) {
-                        QString totStr = lst.at(1);
-                        totStr = totStr.left(totStr.length() - 1);
-                        int total = totStr.toInt();
-                        int left = lst.at(0).toInt();
-                        if (0 == sessionProgress->maximum()) {
-                            sessionProgress->setMaximum(1000);
-                        }
-
-                        if (total > 0 && left <= total) {
-                            if (0 == left) {
-                                sessionProgress->setValue(sessionProgress->maximum());
-                            } else {
-                                sessionProgress->setValue((((total - left) * 1000.0) / total) + 0.5);
-                            }
-                            overallProgress->setValue((1000 * completedSessions) + (sessionProgress->value()));
-                            updateUnity(false);
-                        }
-                    }
-                    break;
-                }
-            }
-        }
-    }
-}
-
 void RunnerDialog::slotButtonClicked(int btn) {
-    if (Dialog::Cancel == btn && process && QProcess::NotRunning != process->state()) {
+    if (Dialog::Cancel == btn && runner->isRunning()) {
         switch (MessageBox::warningYesNoCancel(this, tr("Abort the current synchronisation?"),
                                                tr("Abort"), tr("Abort Now"),
                                                tr("Abort After Current Sync"))) {
         case QMessageBox::Yes:
-            QProcess::startDetached(CARBON_TERMINATE, QStringList() << QString::number(process->pid()));
-            for (int i = 0; i < 50 && QProcess::Running == process->state(); ++i) {
-                Utils::msleep(10);
-            }
-            process->kill();
-            disconnectProcess();
-            if (currentSession != endSession) {
-                (*currentSession)->removeLockFile();
-            }
+            runner->terminate();
             updateUnity(true);
             QDialog::reject();
             break;
         case QMessageBox::No:
-            currentSession = endSession;
+            stopping = true;
+            pipeline.cancel();
+            updatePipeline();
         default:
             break;
         }
+    } else if (Dialog::User2 == btn) {
+        if (runner->isPaused()) {
+            runner->resume();
+        } else {
+            runner->pause();
+        }
+    } else if (Dialog::User1 == btn) {
+        if (!changesDialog) {
+            changesDialog = new ChangeSetDialog(this);
+        }
+        if (changesDialog->run(changes, canApplyChanges)) {
+            applyChanges = true;
+            QDialog::accept();
+        }
     } else {
         Dialog::slotButtonClicked(btn);
     }
 }
 
-void RunnerDialog::disconnectProcess() {
-    if (process) {
-        disconnect(process, SIGNAL(finished(int)), this, SLOT(processFinished(int)));
-        disconnect(process, SIGNAL(readyReadStandardOutput()), this, SLOT(readStdOut()));
-        disconnect(process, SIGNAL(readyReadStandardError()), this, SLOT(readStdErr()));
-        process->deleteLater();
-        process = 0;
+void RunnerDialog::setPaused(bool paused, const QString &reason) {
+    setButtonText(User2, paused ? tr("Resume") : tr("Pause"));
+    if (paused) {
+        pauseReason = reason.isEmpty() ? tr("Paused") : reason;
+        updatePaused();
+        pauseTimer->start(1000);
+    } else {
+        pauseTimer->stop();
+        status->setText(tr("Resumed"));
+    }
+}
+
+void RunnerDialog::updatePaused() {
+    status->setText(tr("%1 (%2)").arg(pauseReason).arg(Utils::formatDuration(runner->pausedTime() / 1000)));
+}
+
+void RunnerDialog::updatePipeline() {
+    QList<Session *> sessions = pipeline.sessions();
+
+    for (int i = 0; i < sessions.count() && i < pipelineView->topLevelItemCount(); ++i) {
+        pipelineView->topLevelItem(i)->setText(1, SessionPipeline::toString(pipeline.state(sessions.at(i))));
     }
 }
 
@@ -24,53 +24,63 @@
 
 #include "dialog.h"
 #include "config.h"
+#include "sessionpipeline.h"
 #include <QList>
-#include <QFile>
 #ifdef QT_QTDBUS_FOUND
 #include <QDBusMessage>
 #endif
 #include "ui_runnerwidget.h"
 
 class Session;
-class QProcess;
+class SessionRunner;
+class ChangeSetModel;
+class ChangeSetDialog;
+class QTimer;
 
 
 class RunnerDialog : public Dialog, Ui::RunnerWidget {
     Q_OBJECT
 
 public:
-    enum EStatus {
-        STARTUP,
-        SYNCING
-    };
-
     RunnerDialog(QWidget *parent);
     virtual ~RunnerDialog();
 
-    void go(const QList<Session *> &sessions, bool dry);
+    void go(const QList<Session *> &sessions, bool dry, bool useChanges = false);
+    // After a dry run, did the user choose to synchronise the change set?
+    bool changesAccepted() const {
+        return applyChanges;
+    }
 
 public Q_SLOTS:
     void doNext();
     void processFinished(int exitCode);
-    void readStdOut();
-    void readStdErr();
+    void setStatus(const QString &str, bool isError);
+    void setChecking(int files);
+    void setSessionProgress(int progress);
+    void appendOutput(const QString &str);
+    void appendError(const QString &str);
     void showDetails(bool show = false);
+    void setPaused(bool paused, const QString &reason);
+    void updatePaused();
 
 private:
-    void processLine(QString &line);
     void slotButtonClicked(int btn);
-    void disconnectProcess();
     void updateUnity(bool finished);
+    void updatePipeline();
 
 private:
-    QList<Session *>::ConstIterator currentSession;
-    QList<Session *>::ConstIterator endSession;
-    QString prevStout;
-    QString stdErr;
+    SessionPipeline pipeline;
+    Session *currentSession;
+    bool stopping; // Abort after the current session
     bool dryRun;
-    QProcess *process;
-    QFile logFile;
-    EStatus syncStatus;
+    bool useChangeSets;
+    bool canApplyChanges;
+    bool applyChanges;
+    SessionRunner *runner;
+    ChangeSetModel *changes;
+    ChangeSetDialog *changesDialog;
+    QTimer *pauseTimer;
+    QString pauseReason;
     int sessionCount;
     int completedSessions;
     #ifdef QT_QTDBUS_FOUND
@@ -0,0 +1,68 @@
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include "runnerprocess.h"
+#include <QTimer>
+#include <signal.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+RunnerProcess::RunnerProcess(QObject *parent)
+    : QProcess(parent) {
+}
+
+RunnerProcess::~RunnerProcess() {
+    // QProcess's destructor waits for the process to exit, so make sure that it does
+    killGroup();
+}
+
+void RunnerProcess::terminateGroup(int timeout) {
+    if (NotRunning != state() && pid() > 0) {
+        ::kill(-pid(), SIGTERM);
+        // If the group is paused, SIGTERM is only delivered once it continues
+        ::kill(-pid(), SIGCONT);
+        QTimer::singleShot(timeout, this, SLOT(killGroup()));
+    }
+}
+
+void RunnerProcess::pauseGroup() {
+    if (NotRunning != state() && pid() > 0) {
+        ::kill(-pid(), SIGSTOP);
+    }
+}
+
+void RunnerProcess::resumeGroup() {
+    if (NotRunning != state() && pid() > 0) {
+        ::kill(-pid(), SIGCONT);
+    }
+}
+
+void RunnerProcess::killGroup() {
+    if (NotRunning != state() && pid() > 0) {
+        ::kill(-pid(), SIGKILL);
+    }
+}
+
+void RunnerProcess::setupChildProcess() {
+    // Called in the child, after fork() - so the runner's PID is its group ID
+    ::setpgid(0, 0);
+}
@@ -0,0 +1,50 @@
+#ifndef __RUNNER_PROCESS_H__
+#define __RUNNER_PROCESS_H__
+
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include <QProcess>
+
+// Starts carbon-runner in its own process group, so that it can be cancelled - along with rsync, ssh, and any
+// parallel shards - by signalling the group.
+class RunnerProcess : public QProcess {
+    Q_OBJECT
+
+public:
+    RunnerProcess(QObject *parent = 0);
+    virtual ~RunnerProcess();
+
+    // Send SIGTERM to the group, and SIGKILL if the runner has not exited after timeout msecs. Does not wait.
+    void terminateGroup(int timeout);
+    // SIGSTOP/SIGCONT the group
+    void pauseGroup();
+    void resumeGroup();
+
+private Q_SLOTS:
+    void killGroup();
+
+protected:
+    void setupChildProcess();
+};
+
+#endif
@@ -0,0 +1,102 @@
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include "runtiming.h"
+#include <QObject>
+#include <QStringList>
+
+static const QString constEnd = QLatin1String("end");
+
+static QString secs(qint64 msecs) {
+    return QObject::tr("%1s").arg(msecs / 1000.0, 0, 'f', 1);
+}
+
+RunTiming::RunTiming() {
+    reset();
+}
+
+void RunTiming::reset() {
+    marks.clear();
+    offset = 0;
+    haveOffset = false;
+    clock.start();
+}
+
+void RunTiming::mark(const QString &name, qint64 runnerMsecs) {
+    if (!marks.isEmpty() && constEnd == marks.last().first) {
+        return;
+    }
+
+    if (runnerMsecs >= 0) {
+        // Track the difference between clocks, so that phases detected here can be placed on the runner's clock
+        offset = runnerMsecs - clock.elapsed();
+        haveOffset = true;
+        marks.append(Phase(name, runnerMsecs));
+    } else if (haveOffset) {
+        marks.append(Phase(name, clock.elapsed() + offset));
+    }
+}
+
+void RunTiming::finish() {
+    if (haveOffset && !marks.isEmpty() && constEnd != marks.last().first) {
+        marks.append(Phase(constEnd, clock.elapsed() + offset));
+    }
+}
+
+QList<RunTiming::Phase> RunTiming::phases() const {
+    QList<Phase> list;
+
+    for (int i = 0; i + 1 < marks.count(); ++i) {
+        qint64 duration = qMax(0LL, marks.at(i + 1).second - marks.at(i).second);
+        bool found = false;
+        for (int p = 0; p < list.count() && !found; ++p) {
+            if (list.at(p).first == marks.at(i).first) {
+                list[p].second += duration;
+                found = true;
+            }
+        }
+        if (!found) {
+            list.append(Phase(marks.at(i).first, duration));
+        }
+    }
+    return list;
+}
+
+qint64 RunTiming::total() const {
+    return marks.count() < 2 ? 0 : marks.last().second - marks.first().second;
+}
+
+QString RunTiming::toString() const {
+    QStringList parts;
+    foreach (const Phase &p, phases()) {
+        parts.append(p.first + QLatin1Char(' ') + secs(p.second));
+    }
+    return parts.join(QLatin1String(", ")) + QLatin1String(" (") + secs(total()) + QLatin1Char(')');
+}
+
+QString RunTiming::toHistory() const {
+    QString str;
+    foreach (const Phase &p, phases()) {
+        str += p.first + QLatin1Char('=') + QString::number(p.second) + QLatin1Char(' ');
+    }
+    return str + QLatin1String("total=") + QString::number(total());
+}
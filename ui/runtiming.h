@@ -0,0 +1,66 @@
+#ifndef __RUN_TIMING_H__
+#define __RUN_TIMING_H__
+
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include <QString>
+#include <QList>
+#include <QPair>
+#include <QElapsedTimer>
+
+// Per-phase breakdown of a run, built from the runner's phase markers. Each marker starts a phase, which lasts
+// until the next marker.
+class RunTiming {
+public:
+    typedef QPair<QString, qint64> Phase; // name, duration in msecs
+
+    RunTiming();
+
+    void reset();
+    // runnerMsecs is the runner's (monotonic) timestamp. If < 0, the phase starts now - as detected by the GUI.
+    void mark(const QString &name, qint64 runnerMsecs);
+    // Close the last phase, if the runner did not mark the end
+    void finish();
+    // Name of the phase currently running
+    QString current() const {
+        return marks.isEmpty() ? QString() : marks.last().first;
+    }
+    bool isEmpty() const {
+        return marks.count() < 2;
+    }
+    // Phases in the order they first started. Repeated phases are summed.
+    QList<Phase> phases() const;
+    qint64 total() const;
+    // e.g. "startup 0.1s, scan 2.3s, transfer 10.0s, cleanup 0.4s (12.8s)"
+    QString toString() const;
+    // e.g. "startup=100 scan=2300 transfer=10000 cleanup=400 total=12800"
+    QString toHistory() const;
+
+private:
+    QList<Phase> marks; // name, runner timestamp
+    QElapsedTimer clock;
+    qint64 offset; // runner time - clock time
+    bool haveOffset;
+};
+
+#endif
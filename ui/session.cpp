@@ -20,28 +20,109 @@
 */
 
 #include "session.h"
+#include "sessionfile.h"
 #include "utils.h"
 #include "config.h"
 #include <QFileInfo>
 #include <QDir>
-#include <QDateTime>
 #include <QFile>
-#include <QTextStream>
 #include <unistd.h>
+#include <errno.h>
 
-#define CFG_READ_BOOL(V, DEF)      V=entries.contains(#V) ? QLatin1String("true")==entries[#V] : DEF
-#define CFG_READ_INT(V, DEF)       V=entries.contains(#V) ? entries[#V].toInt() : DEF
-#define CFG_READ_STR(V, DEF)       V=entries.contains(#V) ? entries[#V] : DEF
-#define CFG_READ_STRING(V, DEF)    V=entries.contains(#V) ? entries[#V] : DEF
+#define CFG_READ_BOOL(V, DEF)      V=cfg.boolValue(SessionFile::KEY_##V, DEF)
+#define CFG_READ_INT(V, DEF)       V=cfg.intValue(SessionFile::KEY_##V, DEF)
+#define CFG_READ_STR(V, DEF)       V=cfg.value(SessionFile::KEY_##V, DEF)
+#define CFG_READ_STRING(V, DEF)    V=cfg.value(SessionFile::KEY_##V, DEF)
+#define CFG_READ_QUOTED(V, DEF)    V=cfg.contains(SessionFile::KEY_##V) ? unquote(cfg.value(SessionFile::KEY_##V)) : DEF
 
-#define CFG_WRITE_INT(V)       out << #V << "=" << V << endl
-#define CFG_WRITE_BOOL(V)      out << #V << "=" << (V ? "true" : "false") << endl
-#define CFG_WRITE_STR(V)       out << #V << "=" << V << endl
+#define CFG_WRITE_INT(V)       cfg.addInt(SessionFile::KEY_##V, V)
+#define CFG_WRITE_BOOL(V)      cfg.addBool(SessionFile::KEY_##V, V)
+#define CFG_WRITE_STR(V)       cfg.addString(SessionFile::KEY_##V, V)
+#define CFG_WRITE_QUOTED(V)    cfg.addString(SessionFile::KEY_##V, quote(V))
 
 static QString getName(const QString &f) {
     return QFileInfo(f).fileName().remove(CARBON_EXTENSION);
 }
 
+// The runner eval's the session file, so values that may contain spaces, or quotes, need to be quoted. Characters
+// that are special within double quotes are escaped, so that commands are not expanded until the runner runs them.
+static QString quote(QString str) {
+    if (str.isEmpty()) {
+        return str;
+    }
+
+    QString quoted(QChar('\"'));
+    for (int i = 0; i < str.length(); ++i) {
+        QChar c = str.at(i);
+        if (QLatin1Char('\\') == c || QLatin1Char('\"') == c || QLatin1Char('$') == c || QLatin1Char('`') == c) {
+            quoted += QLatin1Char('\\');
+        }
+        quoted += c;
+    }
+    return quoted + QChar('\"');
+}
+
+static QString unquote(QString str) {
+    if (!str.isEmpty()) {
+        if (QLatin1Char('\"') == str[0]) {
+            str = str.mid(1);
+        }
+        if (!str.isEmpty() && QChar('\"') == str[str.size() - 1]) {
+            str = str.left(str.size() - 1);
+        }
+
+        // Older versions also escaped single quotes, but not backslashes - so other backslashes are kept as-is
+        QString unescaped;
+        for (int i = 0; i < str.length(); ++i) {
+            if (QLatin1Char('\\') == str.at(i) && i + 1 < str.length() &&
+                QString(QLatin1String("\\\"$`'")).contains(str.at(i + 1))) {
+                ++i;
+            }
+            unescaped += str.at(i);
+        }
+        str = unescaped;
+    }
+    return str;
+}
+
+static const char * constLargeFileProfiles[Session::LARGE_FILE_NUM_PROFILES] = { "none", "delta", "vm", "append", "whole" };
+
+static Session::LargeFileProfile toLargeFileProfile(const QString &v) {
+    for (int i = 0; i < Session::LARGE_FILE_NUM_PROFILES; ++i) {
+        if (v == QLatin1String(constLargeFileProfiles[i])) {
+            return (Session::LargeFileProfile)i;
+        }
+    }
+    return Session::LARGE_FILE_NONE;
+}
+
+static const char * constSnapshotModes[Session::SNAPSHOT_NUM_MODES] = { "none", "auto", "btrfs", "lvm", "zfs" };
+
+static Session::SnapshotMode toSnapshotMode(const QString &v) {
+    for (int i = 0; i < Session::SNAPSHOT_NUM_MODES; ++i) {
+        if (v == QLatin1String(constSnapshotModes[i])) {
+            return (Session::SnapshotMode)i;
+        }
+    }
+    return Session::SNAPSHOT_NONE;
+}
+
+static Session::Compression toCompression(const QString &v) {
+    return QLatin1String("true") == v
+           ? Session::COMPRESS_ALWAYS
+           : QLatin1String("auto") == v
+             ? Session::COMPRESS_AUTO
+             : Session::COMPRESS_NONE;
+}
+
+static const char * toStr(Session::Compression v) {
+    switch (v) {
+    case Session::COMPRESS_ALWAYS: return "true";
+    case Session::COMPRESS_AUTO:   return "auto";
+    default:                       return "false";
+    }
+}
+
 Session::Session(const QString &file, bool def)
     : isDef(def)
     , exclude(0) {
@@ -68,21 +149,109 @@ Session::Session(const QString &file, bool def)
         exclude = new ExcludeFile(excludeFileName());
     }
 
-    QFile f(fName);
-    QMap<QString, QString> entries;
-    if (f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QTextStream in(&f);
-        while (!in.atEnd()) {
-            QString line = in.readLine();
-            if (!line.startsWith("#") && !line.startsWith("[") && line.contains('=')) {
-                QStringList parts = line.split("=");
-                if (parts.length() > 1) {
-                    entries[parts.at(0)] = parts.at(1);
-                }
-            }
+    SessionFile cfg;
+    cfg.read(fName);
+    read(cfg);
+}
+
+Session::Session()
+    : isDef(false)
+    , exclude(0L) {
+}
+
+Session::~Session() {
+    delete exclude;
+}
+
+bool Session::save(const QString &name) {
+    SessionFile cfg;
+
+    write(cfg);
+
+    if (!cfg.write(dirName + (isDef ? sessionName : name) + QLatin1String(CARBON_EXTENSION))) {
+        return false;
+    }
+
+    // The exclude file is moved by its save(), below
+    if (!isDef && name != sessionName) {
+        if (!sessionName.isEmpty()) {
+            removeFiles(dirName, sessionName);
         }
+        sessionName = name;
+    }
+
+    if (exclude) {
+        exclude->save(excludeFileName());
+    }
+
+    return true;
+}
+
+bool Session::erase() {
+    bool rv(removeFiles());
+
+    if (rv) {
+        src = QString(); // Stop destructor from saving file!
     }
 
+    return rv;
+}
+
+// Copies this session, under another name, source, and destination. Nothing is saved.
+Session * Session::clone(const QString &name, const QString &source, const QString &destination) const {
+    SessionFile out;
+    SessionFile in;
+    Session *s = new Session;
+
+    write(out);
+    in.read(out.data());
+    s->read(in);
+    s->dirName = isDef ? Utils::dataDir(QString(), true) : dirName;
+    s->sessionName = name;
+    s->src = source;
+    s->dest = destination;
+    s->exclude = new ExcludeFile(s->excludeFileName(), exclude ? exclude->patterns() : ExcludeFile::PatternList());
+    s->setDependencies(s->dependencies());
+    return s;
+}
+
+// Applies the settings that were changed between from, and to, to this session - except for its source and
+// destination. Used to edit several sessions at once, with from and to being a session before and after editing.
+void Session::apply(const Session &from, const Session &to) {
+    SessionFile fromOut;
+    SessionFile toOut;
+    SessionFile thisOut;
+    SessionFile fromIn;
+    SessionFile toIn;
+    SessionFile thisIn;
+    SessionFile merged;
+    SessionFile mergedIn;
+
+    from.write(fromOut);
+    to.write(toOut);
+    write(thisOut);
+    fromIn.read(fromOut.data());
+    toIn.read(toOut.data());
+    thisIn.read(thisOut.data());
+
+    for (int i = 0; i < SessionFile::KEY_NUM_KEYS; ++i) {
+        SessionFile::Key k = (SessionFile::Key)i;
+        bool changed = SessionFile::KEY_src != k && SessionFile::KEY_dest != k && fromIn.value(k) != toIn.value(k);
+
+        merged.addString(k, changed ? toIn.value(k) : thisIn.value(k));
+    }
+    mergedIn.read(merged.data());
+    read(mergedIn);
+    setDependencies(dependencies());
+
+    ExcludeFile::PatternList fromPatterns = from.exclude ? from.exclude->patterns() : ExcludeFile::PatternList();
+    ExcludeFile::PatternList toPatterns = to.exclude ? to.exclude->patterns() : ExcludeFile::PatternList();
+    if (fromPatterns != toPatterns) {
+        setExcludePatterns(toPatterns);
+    }
+}
+
+void Session::read(const SessionFile &cfg) {
     CFG_READ_STR(src, QDir::homePath());
     CFG_READ_STR(dest, QLatin1String("/tmp"));
     CFG_READ_BOOL(archive, true);
@@ -91,7 +260,7 @@ Session::Session(const QString &file, bool def)
     CFG_READ_BOOL(skipReceiverNewerFiles, true);
     CFG_READ_BOOL(keepPartial, false);
     CFG_READ_BOOL(onlyUpdate, false);
-    CFG_READ_BOOL(useCompression, false);
+    useCompression = toCompression(cfg.value(SessionFile::KEY_useCompression));
     CFG_READ_BOOL(checksum, false);
     CFG_READ_BOOL(windowsCompat, false);
     CFG_READ_BOOL(ignoreExisting, false);
@@ -124,56 +293,43 @@ Session::Session(const QString &file, bool def)
         maxFileSize = 0;
     }
 
-    CFG_READ_STRING(customOptions, QString());
+    largeFileProfile = toLargeFileProfile(cfg.value(SessionFile::KEY_largeFileProfile));
+    CFG_READ_INT(largeFileSize, 1024);
+    CFG_READ_QUOTED(largeFilePatterns, QString());
 
-    if (!customOptions.isEmpty()) {
-        if (QLatin1Char('\"') == customOptions[0]) {
-            customOptions = customOptions.mid(1);
-        }
-        if (!customOptions.isEmpty() && QChar('\"') == customOptions[customOptions.size() - 1]) {
-            customOptions = customOptions.left(customOptions.size() - 1);
-        }
-        if (!customOptions.isEmpty()) {
-            customOptions.replace("\\\"", "\"").replace("\\\'", "\'");
-        }
+    if (largeFileSize < 1) {
+        largeFileSize = 1;
     }
 
-    updateLast();
-}
-
-Session::Session()
-    : isDef(false)
-    , exclude(0L) {
-}
-
-Session::~Session() {
-    delete exclude;
-}
-
-void Session::updateLast() {
-    QFile log(logFileName());
-
-    lastSyncDate = !log.exists()
-                   ? QString()
-                   : QFileInfo(log).created().toString(Qt::SystemLocaleShortDate);
-}
-
-bool Session::save(const QString &name) {
-    QString fName = dirName + (isDef ? sessionName : name) + QLatin1String(CARBON_EXTENSION);
-    QFile f(fName);
-
-    if (!f.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        return false;
+    CFG_READ_INT(parallelShards, 1);
+    if (parallelShards > 16) {
+        parallelShards = 16;
+    } else if (parallelShards < 1) {
+        parallelShards = 1;
     }
 
-    if (!isDef && name != sessionName) {
-        removeFiles();
-        sessionName = name;
+    CFG_READ_BOOL(pauseOnBattery, false);
+    CFG_READ_INT(pauseLoad, 0);
+    if (pauseLoad < 0) {
+        pauseLoad = 0;
     }
 
-    QTextStream out(&f);
+    snapshot = toSnapshotMode(cfg.value(SessionFile::KEY_snapshot));
+    CFG_READ_QUOTED(group, QString());
+    CFG_READ_QUOTED(dependsOn, QString());
+    CFG_READ_QUOTED(preCommand, QString());
+    CFG_READ_BOOL(preCommandHalt, true);
+    CFG_READ_QUOTED(successCommand, QString());
+    CFG_READ_QUOTED(failureCommand, QString());
+    CFG_READ_BOOL(successCommandBackground, false);
+    CFG_READ_INT(commandTimeout, 0);
+    CFG_READ_BOOL(hashCatalog, false);
+    CFG_READ_QUOTED(metricsDir, QString());
+
+    CFG_READ_QUOTED(customOptions, QString());
+}
 
-    out << "[Settings]" << endl;
+void Session::write(SessionFile &cfg) const {
     CFG_WRITE_STR(src);
     CFG_WRITE_STR(dest);
     CFG_WRITE_BOOL(archive);
@@ -182,7 +338,7 @@ bool Session::save(const QString &name) {
     CFG_WRITE_BOOL(skipReceiverNewerFiles);
     CFG_WRITE_BOOL(keepPartial);
     CFG_WRITE_BOOL(onlyUpdate);
-    CFG_WRITE_BOOL(useCompression);
+    cfg.addString(SessionFile::KEY_useCompression, toStr(useCompression));
     CFG_WRITE_BOOL(checksum);
     CFG_WRITE_BOOL(windowsCompat);
     CFG_WRITE_BOOL(ignoreExisting);
@@ -199,27 +355,24 @@ bool Session::save(const QString &name) {
     CFG_WRITE_INT(maxBackupAge);
     CFG_WRITE_INT(maxFileSize);
 
-    QString temp = customOptions;
-    if (!temp.isEmpty()) {
-        temp = QChar('\"') + temp.replace('\"', "\\\"").replace('\'', "\\\'") + QChar('\"');
-    }
-    out << "customOptions=" << temp << endl;
-
-    if (exclude) {
-        exclude->save(excludeFileName());
-    }
-
-    return true;
-}
-
-bool Session::erase() {
-    bool rv(removeFiles());
-
-    if (rv) {
-        src = QString(); // Stop destructor from saving file!
-    }
-
-    return rv;
+    cfg.addString(SessionFile::KEY_largeFileProfile, constLargeFileProfiles[largeFileProfile]);
+    CFG_WRITE_INT(largeFileSize);
+    CFG_WRITE_QUOTED(largeFilePatterns);
+    CFG_WRITE_INT(parallelShards);
+    CFG_WRITE_BOOL(pauseOnBattery);
+    CFG_WRITE_INT(pauseLoad);
+    cfg.addString(SessionFile::KEY_snapshot, constSnapshotModes[snapshot]);
+    CFG_WRITE_QUOTED(group);
+    CFG_WRITE_QUOTED(dependsOn);
+    CFG_WRITE_QUOTED(preCommand);
+    CFG_WRITE_BOOL(preCommandHalt);
+    CFG_WRITE_QUOTED(successCommand);
+    CFG_WRITE_QUOTED(failureCommand);
+    CFG_WRITE_BOOL(successCommandBackground);
+    CFG_WRITE_INT(commandTimeout);
+    CFG_WRITE_BOOL(hashCatalog);
+    CFG_WRITE_QUOTED(metricsDir);
+    CFG_WRITE_QUOTED(customOptions);
 }
 
 bool Session::sync(bool dryRun) {
@@ -229,19 +382,22 @@ bool Session::sync(bool dryRun) {
     return false;
 }
 
+// The old session's files are only removed once the new session file has been written
 void Session::setName(const QString &v) {
-    if (v != sessionName && removeFiles()) {
+    if (v != sessionName) {
         QString oldName(sessionName),
                 oldDir(dirName);
 
         dirName = Utils::dataDir(QString(), true);
-        if (save(v)) {
-            lastSyncDate = QString();
-            sessionName = v;
+        sessionName = v;
+        if (save()) {
+            lastRunState = SessionState();
+            if (!oldName.isEmpty()) {
+                removeFiles(oldDir, oldName);
+            }
         } else {
             sessionName = oldName;
             dirName = oldDir;
-            save();
         }
     }
 }
@@ -254,8 +410,31 @@ void Session::setExcludePatterns(const ExcludeFile::PatternList &list) {
     exclude->setPatterns(list);
 }
 
+QStringList Session::dependencies() const {
+    QStringList names;
+    foreach (const QString &n, dependsOn.split(QLatin1Char(','), QString::SkipEmptyParts)) {
+        QString name = n.trimmed();
+        if (!name.isEmpty() && !names.contains(name)) {
+            names.append(name);
+        }
+    }
+    return names;
+}
+
+void Session::setDependencies(const QStringList &v) {
+    QStringList names;
+    foreach (const QString &n, v) {
+        QString name = n.trimmed();
+        if (!name.isEmpty() && name != sessionName && !names.contains(name)) {
+            names.append(name);
+        }
+    }
+    dependsOn = names.join(QLatin1String(","));
+}
+
+// One unlink() per file, rather than checking whether it exists first
 static bool removeFile(const QString &file) {
-    return file.isEmpty() || !QFile::exists(file) || QFile::remove(file);
+    return file.isEmpty() || 0 == ::unlink(QFile::encodeName(file).constData()) || ENOENT == errno;
 }
 
 bool Session::removeLockFile() {
@@ -263,10 +442,22 @@ bool Session::removeLockFile() {
 }
 
 bool Session::removeFiles() {
-    if (removeFile(logFileName()) && removeFile(infoFileName()) && removeFile(lockFileName()) &&
-            (!exclude || exclude->erase()) && removeFile(fileName())) {
-        return true;
-    }
+    return (!exclude || exclude->erase()) && removeFiles(dirName, sessionName);
+}
 
-    return false;
+// Files of the session called name, in dir - other than its exclude file. The session file itself goes last.
+bool Session::removeFiles(const QString &dir, const QString &name) {
+    static const char * constExtensions[] = {
+        CARBON_LOG_EXTENSION, CARBON_INFO_EXTENSION, CARBON_LOCK_EXTENSION, CARBON_HISTORY_EXTENSION,
+        CARBON_CHANGES_EXTENSION, CARBON_STATE_EXTENSION, CARBON_CHECKPOINT_EXTENSION, CARBON_COMMAND_LOG_EXTENSION,
+        CARBON_WATCH_EXTENSION, 0
+    };
+
+    QString base = dir + name + QLatin1String(CARBON_EXTENSION);
+    for (int i = 0; constExtensions[i]; ++i) {
+        if (!removeFile(base + QLatin1String(constExtensions[i]))) {
+            return false;
+        }
+    }
+    return removeFile(base);
 }
@@ -23,12 +23,45 @@
 */
 
 #include <QString>
+#include <QStringList>
 #include <QLatin1String>
 #include "excludefile.h"
+#include "sessionstate.h"
 #include "config.h"
 
+class SessionFile;
+
 class Session {
 public:
+    enum Compression {
+        COMPRESS_NONE,
+        COMPRESS_ALWAYS,
+        COMPRESS_AUTO  // Runner chooses algorithm, and level, based upon link speed
+    };
+
+    // rsync options applied to files above largeFileSize MiB, or matching largeFilePatterns.
+    // See large_file_options in the runner.
+    enum LargeFileProfile {
+        LARGE_FILE_NONE,
+        LARGE_FILE_DELTA,
+        LARGE_FILE_VM,
+        LARGE_FILE_APPEND,
+        LARGE_FILE_WHOLE,
+
+        LARGE_FILE_NUM_PROFILES
+    };
+
+    // Synchronise local sources from a read-only filesystem snapshot. See take_snapshot in the runner.
+    enum SnapshotMode {
+        SNAPSHOT_NONE,
+        SNAPSHOT_AUTO, // Use whichever the source's filesystem supports, else the live source
+        SNAPSHOT_BTRFS,
+        SNAPSHOT_LVM,
+        SNAPSHOT_ZFS,
+
+        SNAPSHOT_NUM_MODES
+    };
+
     Session(const QString &name, bool def = false);
     Session();
     ~Session();
@@ -36,12 +69,18 @@ public:
     operator bool()                                           {
         return !src.isEmpty();
     }
-    void            updateLast();
+    // Re-read the state file, once the session has been run. Sessions without one were last run by an older
+    // runner, if at all.
+    bool            updateLastRun()                           {
+        return lastRunState.read(stateFileName()) || lastRunState.readLegacy(historyFileName(), logFileName());
+    }
     bool            save()                                    {
         return save(sessionName);
     }
     bool            save(const QString &name);
     bool            erase();
+    Session *       clone(const QString &name, const QString &source, const QString &destination) const;
+    void            apply(const Session &from, const Session &to);
     bool            sync(bool dryRun);
 
     bool            removeLockFile();
@@ -66,8 +105,32 @@ public:
     QString         excludeFileName() const                   {
         return dirName + sessionName + QLatin1String(CARBON_EXTENSION CARBON_EXCLUDE_EXTENSION);
     }
-    const QString & last() const                              {
-        return lastSyncDate;
+    QString         historyFileName() const                   {
+        return dirName + sessionName + QLatin1String(CARBON_EXTENSION CARBON_HISTORY_EXTENSION);
+    }
+    QString         stateFileName() const                     {
+        return dirName + sessionName + QLatin1String(CARBON_EXTENSION CARBON_STATE_EXTENSION);
+    }
+    QString         changesFileName() const                   {
+        return dirName + sessionName + QLatin1String(CARBON_EXTENSION CARBON_CHANGES_EXTENSION);
+    }
+    // Exists whilst a run is in progress, or if it was interrupted
+    QString         checkpointFileName() const                {
+        return dirName + sessionName + QLatin1String(CARBON_EXTENSION CARBON_CHECKPOINT_EXTENSION);
+    }
+    // Output of success commands run in the background
+    QString         commandLogFileName() const                {
+        return dirName + sessionName + QLatin1String(CARBON_EXTENSION CARBON_COMMAND_LOG_EXTENSION);
+    }
+    // Batch of changed paths, found whilst watching the source, being synchronised
+    QString         watchFileName() const                     {
+        return dirName + sessionName + QLatin1String(CARBON_EXTENSION CARBON_WATCH_EXTENSION);
+    }
+    const SessionState & lastRun() const                      {
+        return lastRunState;
+    }
+    void            setLastRun(const SessionState &v)         {
+        lastRunState = v;
     }
     const QString & source() const                            {
         return src;
@@ -113,7 +176,7 @@ public:
     bool            onlyUpdateFlag() const                    {
         return onlyUpdate;
     }
-    bool            useCompressionFlag() const                {
+    Compression     compressionMode() const                   {
         return useCompression;
     }
     bool            checksumFlag() const                      {
@@ -161,6 +224,56 @@ public:
     int             maxSize() const                           {
         return maxFileSize;
     }
+    LargeFileProfile largeFileProfileType() const             {
+        return largeFileProfile;
+    }
+    int             largeFileMinSize() const                  {
+        return largeFileSize;
+    }
+    const QString & largeFilePatternList() const              {
+        return largeFilePatterns;
+    }
+    int             shards() const                            {
+        return parallelShards;
+    }
+    bool            pauseOnBatteryFlag() const                {
+        return pauseOnBattery;
+    }
+    int             pauseLoadLimit() const                    {
+        return pauseLoad;
+    }
+    SnapshotMode    snapshotMode() const                      {
+        return snapshot;
+    }
+    const QString & groupName() const                         {
+        return group;
+    }
+    // Names of the sessions that this one must run after, when they are run together
+    QStringList     dependencies() const;
+    const QString & preSyncCommand() const                    {
+        return preCommand;
+    }
+    bool            preSyncCommandHaltFlag() const            {
+        return preCommandHalt;
+    }
+    const QString & successSyncCommand() const                {
+        return successCommand;
+    }
+    const QString & failureSyncCommand() const                {
+        return failureCommand;
+    }
+    bool            successSyncCommandBackgroundFlag() const  {
+        return successCommandBackground;
+    }
+    int             syncCommandTimeout() const                {
+        return commandTimeout;
+    }
+    bool            hashCatalogFlag() const                   {
+        return hashCatalog;
+    }
+    const QString & metricsFolder() const                     {
+        return metricsDir;
+    }
     void            setArchiveFlag(bool v)                    {
         archive = v;
     }
@@ -179,7 +292,7 @@ public:
     void            setOnlyUpdateFlag(bool v)                 {
         onlyUpdate = v;
     }
-    void            setUseCompressionFlag(bool v)             {
+    void            setCompressionMode(Compression v)         {
         useCompression = v;
     }
     void            setChecksumFlag(bool v)                   {
@@ -227,17 +340,69 @@ public:
     void            setMaxSize(int v)                         {
         maxFileSize = v;
     }
+    void            setLargeFileProfileType(LargeFileProfile v) {
+        largeFileProfile = v;
+    }
+    void            setLargeFileMinSize(int v)                {
+        largeFileSize = v;
+    }
+    void            setLargeFilePatternList(const QString &v) {
+        largeFilePatterns = v;
+    }
+    void            setShards(int v)                          {
+        parallelShards = v;
+    }
+    void            setPauseOnBatteryFlag(bool v)             {
+        pauseOnBattery = v;
+    }
+    void            setPauseLoadLimit(int v)                  {
+        pauseLoad = v;
+    }
+    void            setSnapshotMode(SnapshotMode v)           {
+        snapshot = v;
+    }
+    void            setGroupName(const QString &v)            {
+        group = v;
+    }
+    void            setDependencies(const QStringList &v);
+    void            setPreSyncCommand(const QString &v)       {
+        preCommand = v;
+    }
+    void            setPreSyncCommandHaltFlag(bool v)         {
+        preCommandHalt = v;
+    }
+    void            setSuccessSyncCommand(const QString &v)   {
+        successCommand = v;
+    }
+    void            setFailureSyncCommand(const QString &v)   {
+        failureCommand = v;
+    }
+    void            setSuccessSyncCommandBackgroundFlag(bool v) {
+        successCommandBackground = v;
+    }
+    void            setSyncCommandTimeout(int v)              {
+        commandTimeout = v;
+    }
+    void            setHashCatalogFlag(bool v)                {
+        hashCatalog = v;
+    }
+    void            setMetricsFolder(const QString &v)        {
+        metricsDir = v;
+    }
 
 private:
     Session(const Session &o);
 
+    void            read(const SessionFile &cfg);
+    void            write(SessionFile &cfg) const;
     bool            removeFiles();
+    static bool     removeFiles(const QString &dir, const QString &name);
 
 private:
     bool isDef;
     QString dirName;
     QString sessionName;
-    QString lastSyncDate;
+    SessionState lastRunState;
     QString src;
     QString dest;
     bool archive;
@@ -246,7 +411,7 @@ private:
     bool skipReceiverNewerFiles;
     bool keepPartial;
     bool onlyUpdate;
-    bool useCompression;
+    Compression useCompression;
     bool checksum;
     bool windowsCompat;
     bool ignoreExisting;
@@ -262,6 +427,28 @@ private:
     bool cvsExclude;
     int maxBackupAge;
     int maxFileSize;
+    LargeFileProfile largeFileProfile;
+    int largeFileSize;
+    QString largeFilePatterns;
+    int parallelShards;
+    // Pause whilst on battery, or whilst the 1 minute load average is above pauseLoad% of the CPUs (0 to ignore)
+    bool pauseOnBattery;
+    int pauseLoad;
+    SnapshotMode snapshot;
+    QString group;
+    QString dependsOn; // Comma separated session names
+    // Shell commands run by the runner before, and after, synchronising. If preCommandHalt is set, and the pre
+    // command fails, the session is not synchronised.
+    QString preCommand;
+    bool preCommandHalt;
+    QString successCommand;
+    QString failureCommand;
+    // Run the success command detached, so that the run (and its lock) finishes without waiting for it
+    bool successCommandBackground;
+    int commandTimeout; // Seconds, 0 for none
+    // Catalog the content hashes of each backup increment, so that it can be verified later
+    bool hashCatalog;
+    QString metricsDir;
     ExcludeFile *exclude;
     QString customOptions;
 };
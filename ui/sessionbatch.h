@@ -0,0 +1,66 @@
+#ifndef __SESSION_BATCH_H__
+#define __SESSION_BATCH_H__
+
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include <QThread>
+#include <QList>
+
+class Session;
+
+// Saves, or erases, a set of sessions on a worker thread - so that bulk edits, clones, and deletes of hundreds of
+// sessions are one pass over their files, without blocking the GUI. The sessions must not be used until finished()
+// is emitted, after which failures() lists those that could not be saved, or erased.
+class SessionBatch : public QThread {
+    Q_OBJECT
+
+public:
+    enum Operation {
+        OP_SAVE,
+        OP_ERASE
+    };
+
+    SessionBatch(QObject *parent = 0);
+    virtual ~SessionBatch();
+
+    void process(Operation op, const QList<Session *> &list);
+    Operation operation() const {
+        return currentOp;
+    }
+    const QList<Session *> & sessions() const {
+        return sessionList;
+    }
+    const QList<Session *> & failures() const {
+        return failureList;
+    }
+
+protected:
+    void run();
+
+private:
+    Operation currentOp;
+    QList<Session *> sessionList;
+    QList<Session *> failureList;
+};
+
+#endif
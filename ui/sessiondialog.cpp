@@ -25,6 +25,7 @@
 #include "generaloptionswidget.h"
 #include "excludewidget.h"
 #include "rsyncoptionswidget.h"
+#include "advancedoptionswidget.h"
 #include "mainwindow.h"
 #include "messagebox.h"
 #include "pagewidget.h"
@@ -41,20 +42,24 @@ SessionDialog::SessionDialog(QWidget *parent)
     generalOptions = new GeneralOptionsWidget(0);
     excludeWidget = new ExcludeWidget(0);
     rSyncOptionsWidget = new RSyncOptionsWidget(0);
+    advancedOptionsWidget = new AdvancedOptionsWidget(0);
 
     generalPage = pageWidget->addPage(generalOptions, tr("General Options"), QIcon::fromTheme("folder"), tr("Basic Synchronisation Session Options"));
     excludePage = pageWidget->addPage(excludeWidget, tr("Exclusions"), QIcon::fromTheme("edit-delete"), tr("Exclude Files And Folders From Synchronisation"));
     rSyncOptionsPage = pageWidget->addPage(rSyncOptionsWidget, tr("Backend Options"), MainWindow::appIcon, tr("RSync Backend Options"));
+    advancedPage = pageWidget->addPage(advancedOptionsWidget, tr("Advanced"), QIcon::fromTheme("preferences-other"), tr("Advanced Session Options"));
     setMainWidget(pageWidget);
 }
 
-bool SessionDialog::run(Session &session, bool edit) {
+// With a count above 1, session holds the settings of several sessions being edited together
+bool SessionDialog::run(Session &session, bool edit, int count) {
     origName = edit ? session.name() : QString();
     origSrcPath = edit ? session.source() : QString();
-    setCaption(edit ? tr("Edit Session") : tr("Create New Session"));
-    generalOptions->set(session, edit);
+    setCaption(count > 1 ? tr("Edit %1 Sessions").arg(count) : edit ? tr("Edit Session") : tr("Create New Session"));
+    generalOptions->set(session, edit, count > 1);
     excludeWidget->set(session);
     rSyncOptionsWidget->set(session);
+    advancedOptionsWidget->set(session);
     pageWidget->setCurrentPage(generalPage);
 
     return QDialog::Accepted == exec();
@@ -130,5 +135,6 @@ MessageBox::error(this, tr("Remote URLs require user and host."));
 void SessionDialog::get(Session &session) {
     excludeWidget->get(session);
     rSyncOptionsWidget->get(session);
+    advancedOptionsWidget->get(session);
     generalOptions->get(session);
 }
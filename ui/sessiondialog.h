@@ -28,6 +28,7 @@ class Session;
 class GeneralOptionsWidget;
 class ExcludeWidget;
 class RSyncOptionsWidget;
+class AdvancedOptionsWidget;
 class PageWidget;
 class PageWidgetItem;
 
@@ -37,7 +38,7 @@ class SessionDialog : public Dialog {
 public:
     SessionDialog(QWidget *parent);
 
-    bool run(Session &session, bool edit);
+    bool run(Session &session, bool edit, int count = 1);
     void slotButtonClicked(int btn);
     void get(Session &session);
     void getRSyncDefaults(Session &session);
@@ -53,9 +54,11 @@ private:
     GeneralOptionsWidget *generalOptions;
     ExcludeWidget *excludeWidget;
     RSyncOptionsWidget *rSyncOptionsWidget;
+    AdvancedOptionsWidget *advancedOptionsWidget;
     PageWidgetItem *generalPage;
     PageWidgetItem *excludePage;
     PageWidgetItem *rSyncOptionsPage;
+    PageWidgetItem *advancedPage;
 };
 
 #endif
@@ -0,0 +1,172 @@
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include "sessionfile.h"
+#include "storage.h"
+#include <string.h>
+
+static const char * constKeys[SessionFile::KEY_NUM_KEYS] = {
+#define SESSION_FILE_KEY(K) #K,
+    SESSION_FILE_KEYS
+#undef SESSION_FILE_KEY
+};
+
+SessionFile::Key SessionFile::find(const char *key, int len) {
+    int low = 0;
+    int high = KEY_NUM_KEYS - 1;
+
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        int cmp = strncmp(constKeys[mid], key, len);
+
+        if (0 == cmp && '\0' != constKeys[mid][len]) {
+            cmp = 1; // Table key is longer, so is after this one
+        }
+        if (0 == cmp) {
+            return (Key)mid;
+        } else if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return KEY_UNKNOWN;
+}
+
+const char * SessionFile::name(Key k) {
+    return k < KEY_NUM_KEYS ? constKeys[k] : 0;
+}
+
+SessionFile::SessionFile()
+    : buffer(0) {
+    for (int i = 0; i < KEY_NUM_KEYS; ++i) {
+        values[i].start = values[i].len = -1;
+    }
+}
+
+SessionFile::~SessionFile() {
+    file.close(); // Also removes the mapping
+}
+
+bool SessionFile::read(const QString &fileName) {
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    int size = (int)file.size();
+    if (0 == size) {
+        return true;
+    }
+
+    buffer = (const char *)file.map(0, size);
+    if (!buffer) {
+        contents = file.readAll();
+        buffer = contents.constData();
+        size = contents.size();
+    }
+
+    parse(size);
+    return true;
+}
+
+void SessionFile::read(const QByteArray &data) {
+    contents = data;
+    buffer = contents.constData();
+    parse(contents.size());
+}
+
+void SessionFile::parse(int size) {
+    const char *end = buffer + size;
+    for (const char *line = buffer; line < end;) {
+        const char *eol = (const char *)memchr(line, '\n', end - line);
+        const char *next = eol ? eol + 1 : end;
+
+        if (!eol) {
+            eol = end;
+        }
+        if (eol > line && '\r' == eol[-1]) {
+            --eol;
+        }
+
+        if (eol > line && '#' != line[0] && '[' != line[0]) {
+            const char *eq = (const char *)memchr(line, '=', eol - line);
+
+            if (eq) {
+                Key k = find(line, eq - line);
+
+                if (KEY_UNKNOWN != k) {
+                    values[k].start = (eq + 1) - buffer;
+                    values[k].len = eol - (eq + 1);
+                }
+            }
+        }
+        line = next;
+    }
+}
+
+QString SessionFile::value(Key k, const QString &def) const {
+    return contains(k) ? QString::fromUtf8(buffer + values[k].start, values[k].len) : def;
+}
+
+bool SessionFile::boolValue(Key k, bool def) const {
+    return contains(k) ? 4 == values[k].len && 0 == memcmp(buffer + values[k].start, "true", 4) : def;
+}
+
+int SessionFile::intValue(Key k, int def) const {
+    return contains(k) ? QByteArray::fromRawData(buffer + values[k].start, values[k].len).toInt() : def;
+}
+
+void SessionFile::addString(Key k, const QString &v) {
+    addKey(k);
+    out += v.toUtf8();
+    out += '\n';
+}
+
+void SessionFile::addString(Key k, const char *v) {
+    addKey(k);
+    out += v;
+    out += '\n';
+}
+
+void SessionFile::addBool(Key k, bool v) {
+    addString(k, v ? "true" : "false");
+}
+
+void SessionFile::addInt(Key k, int v) {
+    addKey(k);
+    out += QByteArray::number(v);
+    out += '\n';
+}
+
+bool SessionFile::write(const QString &fileName) const {
+    return Storage::write(fileName, out);
+}
+
+void SessionFile::addKey(Key k) {
+    if (out.isEmpty()) {
+        out.reserve(2048);
+        out += "[Settings]\n";
+    }
+    out += constKeys[k];
+    out += '=';
+}
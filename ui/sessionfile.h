@@ -0,0 +1,136 @@
+#ifndef __SESSION_FILE_H__
+#define __SESSION_FILE_H__
+
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include <QByteArray>
+#include <QString>
+#include <QFile>
+
+// Keys of a session file, in strcmp() order - SessionFile::find() does a binary search of these.
+#define SESSION_FILE_KEYS \
+    SESSION_FILE_KEY(archive) \
+    SESSION_FILE_KEY(checksum) \
+    SESSION_FILE_KEY(commandTimeout) \
+    SESSION_FILE_KEY(copySymlinksAsSymlinks) \
+    SESSION_FILE_KEY(customOptions) \
+    SESSION_FILE_KEY(cvsExclude) \
+    SESSION_FILE_KEY(deleteExtraFilesOnReceiver) \
+    SESSION_FILE_KEY(dependsOn) \
+    SESSION_FILE_KEY(dest) \
+    SESSION_FILE_KEY(dontLeaveFileSystem) \
+    SESSION_FILE_KEY(failureCommand) \
+    SESSION_FILE_KEY(group) \
+    SESSION_FILE_KEY(hashCatalog) \
+    SESSION_FILE_KEY(ignoreExisting) \
+    SESSION_FILE_KEY(keepPartial) \
+    SESSION_FILE_KEY(largeFilePatterns) \
+    SESSION_FILE_KEY(largeFileProfile) \
+    SESSION_FILE_KEY(largeFileSize) \
+    SESSION_FILE_KEY(makeBackups) \
+    SESSION_FILE_KEY(maxBackupAge) \
+    SESSION_FILE_KEY(maxFileSize) \
+    SESSION_FILE_KEY(metricsDir) \
+    SESSION_FILE_KEY(modificationTimes) \
+    SESSION_FILE_KEY(onlyUpdate) \
+    SESSION_FILE_KEY(parallelShards) \
+    SESSION_FILE_KEY(pauseLoad) \
+    SESSION_FILE_KEY(pauseOnBattery) \
+    SESSION_FILE_KEY(preCommand) \
+    SESSION_FILE_KEY(preCommandHalt) \
+    SESSION_FILE_KEY(preserveGroup) \
+    SESSION_FILE_KEY(preserveOwner) \
+    SESSION_FILE_KEY(preservePermissions) \
+    SESSION_FILE_KEY(preserveSpecialFiles) \
+    SESSION_FILE_KEY(recursive) \
+    SESSION_FILE_KEY(skipFilesOnSizeMatch) \
+    SESSION_FILE_KEY(skipReceiverNewerFiles) \
+    SESSION_FILE_KEY(snapshot) \
+    SESSION_FILE_KEY(src) \
+    SESSION_FILE_KEY(successCommand) \
+    SESSION_FILE_KEY(successCommandBackground) \
+    SESSION_FILE_KEY(useCompression) \
+    SESSION_FILE_KEY(windowsCompat)
+
+// Reads, and writes, the key=value [Settings] file of a session.
+//
+// read() parses the file in one pass over a memory mapping of it, and only records where each value starts and ends -
+// values are converted when they are asked for. Everything after the first '=' of a line is its value.
+//
+// The add*() calls append entries, in the order they are made, to a single buffer, which write() then saves with
+// Storage::write() - so the file is either the old, or the new, session; never a mix.
+class SessionFile {
+public:
+    enum Key {
+#define SESSION_FILE_KEY(K) KEY_##K,
+        SESSION_FILE_KEYS
+#undef SESSION_FILE_KEY
+
+        KEY_NUM_KEYS,
+        KEY_UNKNOWN = KEY_NUM_KEYS
+    };
+
+    static Key find(const char *key, int len);
+    static const char * name(Key k);
+
+    SessionFile();
+    ~SessionFile();
+
+    bool read(const QString &fileName);
+    void read(const QByteArray &data);
+    bool contains(Key k) const {
+        return values[k].start >= 0;
+    }
+    QString value(Key k, const QString &def = QString()) const;
+    bool boolValue(Key k, bool def) const;
+    int intValue(Key k, int def) const;
+
+    void addString(Key k, const QString &v);
+    void addString(Key k, const char *v);
+    void addBool(Key k, bool v);
+    void addInt(Key k, int v);
+    bool write(const QString &fileName) const;
+    const QByteArray & data() const {
+        return out;
+    }
+
+private:
+    Q_DISABLE_COPY(SessionFile)
+
+    void parse(int size);
+    void addKey(Key k);
+
+private:
+    struct Value {
+        int start;
+        int len;
+    };
+
+    QFile file;
+    const char *buffer;
+    QByteArray contents; // Only used if reading from memory, or the file could not be mapped
+    Value values[KEY_NUM_KEYS];
+    QByteArray out;
+};
+
+#endif
@@ -0,0 +1,267 @@
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include "sessionmodel.h"
+#include "session.h"
+#include "sessionrunner.h"
+#include "utils.h"
+#include <QDateTime>
+
+static QString typeStr(bool backup) {
+    return backup ? QObject::tr("Backup") : QObject::tr("Synchronisation");
+}
+
+SessionModel::SessionModel(QObject *parent)
+    : QAbstractItemModel(parent) {
+}
+
+SessionModel::~SessionModel() {
+    foreach (const Item &i, items) {
+        delete i.session;
+    }
+}
+
+void SessionModel::set(const QList<Session *> &list) {
+    beginResetModel();
+    foreach (const Item &i, items) {
+        delete i.session;
+    }
+    items.clear();
+    foreach (Session *s, list) {
+        items.append(Item(s));
+    }
+    reindex();
+    endResetModel();
+}
+
+void SessionModel::add(const QList<Session *> &list) {
+    if (list.isEmpty()) {
+        return;
+    }
+
+    beginInsertRows(QModelIndex(), items.count(), items.count() + list.count() - 1);
+    foreach (Session *s, list) {
+        items.append(Item(s));
+        addToIndex(items.last(), items.count() - 1);
+    }
+    endInsertRows();
+}
+
+// Rows after the first removed one all move, so this is one reset for the whole set
+void SessionModel::remove(const QSet<Session *> &set) {
+    if (set.isEmpty()) {
+        return;
+    }
+
+    beginResetModel();
+    for (int i = items.count() - 1; i >= 0; --i) {
+        if (set.contains(items.at(i).session)) {
+            delete items.takeAt(i).session;
+        }
+    }
+    reindex();
+    endResetModel();
+}
+
+void SessionModel::update(const QSet<Session *> &set) {
+    foreach (Session *s, set) {
+        int row = positions.value(s, -1);
+        if (row < 0) {
+            continue;
+        }
+
+        Item &item = items[row];
+        removeFromIndex(item);
+        addToIndex(item, row);
+        item.toolTip = QString();
+        emit dataChanged(createIndex(row, 0, (quintptr)0), createIndex(row, NUM_COLS - 1, (quintptr)0));
+    }
+}
+
+QModelIndex SessionModel::index(int row, int column, const QModelIndex &parent) const {
+    if (parent.isValid() || row < 0 || row >= items.count() || column < 0 || column >= NUM_COLS) {
+        return QModelIndex();
+    }
+    return createIndex(row, column, (quintptr)0);
+}
+
+QModelIndex SessionModel::parent(const QModelIndex &child) const {
+    Q_UNUSED(child)
+    return QModelIndex();
+}
+
+int SessionModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : items.count();
+}
+
+int SessionModel::columnCount(const QModelIndex &parent) const {
+    Q_UNUSED(parent)
+    return NUM_COLS;
+}
+
+QVariant SessionModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= items.count()) {
+        return QVariant();
+    }
+
+    const Item &item = items.at(index.row());
+    const Session *s = item.session;
+    const SessionState &last = s->lastRun();
+
+    switch (role) {
+    case Qt::TextAlignmentRole:
+        return COL_DURATION == index.column() || COL_SIZE == index.column()
+               ? int(Qt::AlignRight | Qt::AlignVCenter) : int(Qt::AlignLeft | Qt::AlignVCenter);
+    case Qt::ToolTipRole:
+        return toolTip(item);
+    case FilterRole:
+        return s->name() + QLatin1Char('\n') + s->groupName() + QLatin1Char('\n') + s->source() + QLatin1Char('\n') +
+               s->destination();
+    case SortRole:
+        switch (index.column()) {
+        case COL_LAST_RUN:
+            return last.time();
+        case COL_DURATION:
+            return last.durationMs();
+        case COL_SIZE:
+            return last.bytes();
+        case COL_STATUS:
+            return last.exitCode();
+        default:
+            break;
+        }
+        break;
+    case Qt::DisplayRole:
+        break;
+    default:
+        return QVariant();
+    }
+
+    switch (index.column()) {
+    case COL_NAME:
+        return s->name();
+    case COL_TYPE:
+        return typeStr(s->makeBackupsFlag());
+    case COL_GROUP:
+        return s->groupName();
+    case COL_LAST_RUN:
+        return last.isNull() ? tr("Never") : QDateTime::fromTime_t(last.time()).toString(Qt::SystemLocaleShortDate);
+    case COL_DURATION:
+        return last.durationMs() < 0 ? QVariant() : QVariant(Utils::formatDuration(last.durationMs() / 1000));
+    case COL_SIZE:
+        return last.bytes() < 0 ? QVariant() : QVariant(Utils::formatByteSize(last.bytes()));
+    case COL_STATUS:
+        return status(last);
+    default:
+        return QVariant();
+    }
+}
+
+QVariant SessionModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (Qt::Horizontal != orientation || Qt::DisplayRole != role) {
+        return QVariant();
+    }
+
+    switch (section) {
+    case COL_NAME:     return tr("Session");
+    case COL_TYPE:     return tr("Type");
+    case COL_GROUP:    return tr("Group");
+    case COL_LAST_RUN: return tr("Last Sync");
+    case COL_DURATION: return tr("Duration");
+    case COL_SIZE:     return tr("Transferred");
+    case COL_STATUS:   return tr("Status");
+    default:           return QVariant();
+    }
+}
+
+QString SessionModel::toolTip(const Item &item) const {
+    if (item.toolTip.isEmpty()) {
+        const Session *s = item.session;
+        QString tip(tr("<p><h3>%1</h3></p><p>"
+                       "<table>"
+                       "<tr><td>Source:</td><td>%2</td></tr>"
+                       "<tr><td>Destination:</td><td>%3</td></tr>")
+                    .arg(s->name())
+                    .arg(s->source())
+                    .arg(s->destination()));
+        QStringList deps = s->dependencies();
+        if (!deps.isEmpty()) {
+            tip += tr("<tr><td>Runs after:</td><td>%1</td></tr>").arg(deps.join(QLatin1String(", ")));
+        }
+        const SessionState &last = s->lastRun();
+        if (!last.isNull() && last.exitCode() > 0) {
+            tip += tr("<tr><td>Last error:</td><td>%1</td></tr>").arg(SessionRunner::errorString(last.exitCode()));
+        }
+        item.toolTip = tip + QLatin1String("</table></p>");
+    }
+    return item.toolTip;
+}
+
+QString SessionModel::status(const SessionState &state) const {
+    if (state.isNull() || state.exitCode() < 0) {
+        return QString();
+    }
+
+    QString str;
+    switch (state.exitCode()) {
+    case 0:
+        str = tr("Succeeded");
+        break;
+    case 20:
+        str = tr("Cancelled");
+        break;
+    case 24:
+        str = tr("Partial");
+        break;
+    default:
+        str = tr("Failed");
+        break;
+    }
+    return state.dryRun() ? tr("%1 (dry run)").arg(str) : str;
+}
+
+void SessionModel::addToIndex(Item &item, int row) {
+    item.name = item.session->name();
+    item.source = item.session->source();
+    rows.insert(item.name, row);
+    positions.insert(item.session, row);
+    ++sources[item.source];
+}
+
+void SessionModel::removeFromIndex(const Item &item) {
+    rows.remove(item.name);
+    positions.remove(item.session);
+
+    QHash<QString, int>::Iterator it = sources.find(item.source);
+    if (it != sources.end() && --it.value() <= 0) {
+        sources.erase(it);
+    }
+}
+
+void SessionModel::reindex() {
+    rows.clear();
+    positions.clear();
+    sources.clear();
+    for (int i = 0; i < items.count(); ++i) {
+        addToIndex(items[i], i);
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef __SESSION_MODEL_H__
+#define __SESSION_MODEL_H__
+
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include <QAbstractItemModel>
+#include <QList>
+#include <QHash>
+#include <QSet>
+
+class Session;
+class SessionState;
+
+// Flat list of sessions, for SessionWidget. Sessions are indexed by name, and by source, so that lookups do not scan
+// the list. Tooltips are only built when first shown. The last run columns show each session's lastRun(), which
+// the caller reads - see SessionState::readDir().
+class SessionModel : public QAbstractItemModel {
+    Q_OBJECT
+
+public:
+    enum Columns {
+        COL_NAME,
+        COL_TYPE,
+        COL_GROUP,
+        COL_LAST_RUN,
+        COL_DURATION,
+        COL_SIZE,
+        COL_STATUS,
+
+        NUM_COLS
+    };
+
+    enum Roles {
+        FilterRole = Qt::UserRole, // Name, group, source, and destination
+        SortRole
+    };
+
+    SessionModel(QObject *parent = 0);
+    virtual ~SessionModel();
+
+    // The model owns its sessions
+    void set(const QList<Session *> &list);
+    void add(const QList<Session *> &list);
+    void remove(const QSet<Session *> &set);
+    // Sessions that were edited, or run
+    void update(const QSet<Session *> &set);
+
+    bool exists(const QString &name) const {
+        return rows.contains(name);
+    }
+    bool srcExists(const QString &src) const {
+        return sources.contains(src);
+    }
+    int count() const {
+        return items.count();
+    }
+    Session * session(int row) const {
+        return row >= 0 && row < items.count() ? items.at(row).session : 0;
+    }
+    Session * session(const QModelIndex &index) const {
+        return index.isValid() ? session(index.row()) : 0;
+    }
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+    QModelIndex parent(const QModelIndex &child) const;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+
+private:
+    struct Item {
+        Item(Session *s = 0)
+            : session(s) {
+        }
+
+        Session *session;
+        QString name;    // As indexed - the session may have since been renamed, or moved
+        QString source;
+        mutable QString toolTip;
+    };
+
+    QString toolTip(const Item &item) const;
+    QString status(const SessionState &state) const;
+    void addToIndex(Item &item, int row);
+    void removeFromIndex(const Item &item);
+    void reindex();
+
+private:
+    QList<Item> items;
+    QHash<QString, int> rows;                 // Name -> row
+    QHash<const Session *, int> positions;    // Session -> row
+    QHash<QString, int> sources;              // Source -> number of sessions using it
+};
+
+#endif
@@ -0,0 +1,207 @@
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include "sessionpipeline.h"
+#include "session.h"
+#include <QObject>
+#include <QMap>
+#include <QStringList>
+
+QString SessionPipeline::toString(State state) {
+    switch (state) {
+    case STATE_WAITING:   return QObject::tr("Waiting");
+    case STATE_RUNNING:   return QObject::tr("Running");
+    case STATE_SUCCEEDED: return QObject::tr("Finished");
+    case STATE_FAILED:    return QObject::tr("Failed");
+    case STATE_SKIPPED:   return QObject::tr("Skipped");
+    }
+    return QString();
+}
+
+SessionPipeline::SessionPipeline() {
+}
+
+bool SessionPipeline::set(const QList<Session *> &sessions) {
+    QMap<QString, int> byName;
+    QList<QList<int> > deps;
+
+    entries.clear();
+    errorStr = QString();
+
+    for (int i = 0; i < sessions.count(); ++i) {
+        byName.insert(sessions.at(i)->name(), i);
+    }
+    foreach (Session *s, sessions) {
+        QList<int> d;
+        foreach (const QString &name, s->dependencies()) {
+            if (byName.contains(name)) {
+                d.append(byName[name]);
+            }
+        }
+        deps.append(d);
+    }
+
+    // Repeatedly take the first session whose dependencies have all been taken, so that the original order is kept
+    // where the dependencies allow.
+    QList<int> order;
+    QList<int> position;
+    QList<bool> placed;
+    for (int i = 0; i < sessions.count(); ++i) {
+        position.append(-1);
+        placed.append(false);
+    }
+
+    while (order.count() < sessions.count()) {
+        int found = -1;
+        for (int i = 0; i < sessions.count() && found < 0; ++i) {
+            if (!placed.at(i)) {
+                bool ready = true;
+                foreach (int d, deps.at(i)) {
+                    if (!placed.at(d)) {
+                        ready = false;
+                        break;
+                    }
+                }
+                if (ready) {
+                    found = i;
+                }
+            }
+        }
+
+        if (found < 0) {
+            QStringList names;
+            for (int i = 0; i < sessions.count(); ++i) {
+                if (!placed.at(i)) {
+                    names.append(sessions.at(i)->name());
+                }
+            }
+            errorStr = QObject::tr("Sessions depend upon each other: %1").arg(names.join(QLatin1String(", ")));
+            return false;
+        }
+        placed[found] = true;
+        position[found] = order.count();
+        order.append(found);
+    }
+
+    foreach (int i, order) {
+        Entry e(sessions.at(i));
+        foreach (int d, deps.at(i)) {
+            e.deps.append(position.at(d));
+        }
+        entries.append(e);
+    }
+    return true;
+}
+
+QList<Session *> SessionPipeline::sessions() const {
+    QList<Session *> list;
+    foreach (const Entry &e, entries) {
+        list.append(e.session);
+    }
+    return list;
+}
+
+SessionPipeline::State SessionPipeline::state(const Session *s) const {
+    int idx = indexOf(s);
+    return idx < 0 ? STATE_SKIPPED : entries.at(idx).state;
+}
+
+Session * SessionPipeline::next() {
+    for (int i = 0; i < entries.count(); ++i) {
+        Entry &e = entries[i];
+        if (STATE_WAITING == e.state) {
+            bool ready = true;
+            foreach (int d, e.deps) {
+                if (STATE_SUCCEEDED != entries.at(d).state) {
+                    ready = false;
+                    break;
+                }
+            }
+            if (ready) {
+                e.state = STATE_RUNNING;
+                return e.session;
+            }
+        }
+    }
+    return 0;
+}
+
+QList<Session *> SessionPipeline::finished(Session *s, bool ok) {
+    QList<Session *> skipped;
+    int idx = indexOf(s);
+
+    if (idx < 0) {
+        return skipped;
+    }
+
+    entries[idx].state = ok ? STATE_SUCCEEDED : STATE_FAILED;
+    if (!ok) {
+        // Entries follow their dependencies, so one pass catches indirect dependants
+        for (int i = idx + 1; i < entries.count(); ++i) {
+            Entry &e = entries[i];
+            if (STATE_WAITING == e.state) {
+                foreach (int d, e.deps) {
+                    if (STATE_FAILED == entries.at(d).state || STATE_SKIPPED == entries.at(d).state) {
+                        e.state = STATE_SKIPPED;
+                        skipped.append(e.session);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    return skipped;
+}
+
+QList<Session *> SessionPipeline::cancel() {
+    QList<Session *> skipped;
+    for (int i = 0; i < entries.count(); ++i) {
+        if (STATE_WAITING == entries.at(i).state) {
+            entries[i].state = STATE_SKIPPED;
+            skipped.append(entries.at(i).session);
+        }
+    }
+    return skipped;
+}
+
+bool SessionPipeline::isFinished() const {
+    return 0 == count(STATE_WAITING) && 0 == count(STATE_RUNNING);
+}
+
+int SessionPipeline::count(State state) const {
+    int c = 0;
+    foreach (const Entry &e, entries) {
+        if (state == e.state) {
+            c++;
+        }
+    }
+    return c;
+}
+
+int SessionPipeline::indexOf(const Session *s) const {
+    for (int i = 0; i < entries.count(); ++i) {
+        if (s == entries.at(i).session) {
+            return i;
+        }
+    }
+    return -1;
+}
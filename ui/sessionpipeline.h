@@ -0,0 +1,85 @@
+#ifndef __SESSION_PIPELINE_H__
+#define __SESSION_PIPELINE_H__
+
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include <QString>
+#include <QList>
+
+class Session;
+
+// Orders a set of sessions so that each runs after the sessions it depends upon (Session::dependencies()), and
+// tracks their progress. Sessions whose dependencies have all succeeded may run in parallel. If a session fails, all
+// sessions that depend upon it, directly or not, are skipped. Dependencies upon sessions that are not part of the
+// set are ignored.
+class SessionPipeline {
+public:
+    enum State {
+        STATE_WAITING,
+        STATE_RUNNING,
+        STATE_SUCCEEDED,
+        STATE_FAILED,
+        STATE_SKIPPED
+    };
+
+    static QString toString(State state);
+
+    SessionPipeline();
+
+    // Returns false, and sets error(), if the dependencies form a cycle.
+    bool set(const QList<Session *> &sessions);
+    const QString & error() const {
+        return errorStr;
+    }
+    // Sessions, in the order they will be started if run one at a time.
+    QList<Session *> sessions() const;
+    State state(const Session *s) const;
+    // Next session that can be started, marked as running. Returns 0 if there is none - either as all are finished,
+    // or as those left are waiting on running sessions.
+    Session * next();
+    // Mark a running session as finished. Returns the sessions skipped as a result.
+    QList<Session *> finished(Session *s, bool ok);
+    // Skip all sessions that have not been started. Returns those skipped.
+    QList<Session *> cancel();
+    bool isFinished() const;
+    int count(State state) const;
+
+private:
+    struct Entry {
+        Entry(Session *s = 0)
+            : session(s)
+            , state(STATE_WAITING) {
+        }
+        Session *session;
+        State state;
+        QList<int> deps; // Indexes, into entries, of the sessions this one depends upon
+    };
+
+    int indexOf(const Session *s) const;
+
+private:
+    QList<Entry> entries; // Sorted so that each entry follows its dependencies
+    QString errorStr;
+};
+
+#endif
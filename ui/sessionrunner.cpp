@@ -0,0 +1,378 @@
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+#include "sessionrunner.h"
+#include "outputparser.h"
+#include "runnerprocess.h"
+#include "session.h"
+#include "config.h"
+#include <QTextStream>
+#include <QStringList>
+#include <QDateTime>
+
+SessionRunner::SessionRunner(QObject *parent)
+    : QObject(parent)
+    , runner(QLatin1String(CARBON_RUNNER))
+    , currentSession(0)
+    , isDryRun(false)
+    , isVerify(false)
+    , usingChanges(false)
+    , autoPause(new AutoPause(this))
+    , paused(false)
+    , autoPaused(false)
+    , pauseOverridden(false)
+    , pausedMsecs(0)
+    , process(0)
+    , parser(new OutputParser(this)) {
+    connect(parser, SIGNAL(status(QString, bool)), this, SIGNAL(status(QString, bool)));
+    connect(parser, SIGNAL(checking(int)), this, SIGNAL(checking(int)));
+    connect(parser, SIGNAL(fileProgress(int)), this, SIGNAL(fileProgress(int)));
+    connect(parser, SIGNAL(sessionProgress(int)), this, SIGNAL(sessionProgress(int)));
+    connect(parser, SIGNAL(item(QString, qint64, QString)), this, SLOT(addItem(QString, qint64, QString)));
+    connect(parser, SIGNAL(phase(QString, qint64)), this, SLOT(addPhase(QString, qint64)));
+    connect(autoPause, SIGNAL(changed(AutoPause::Reason)), this, SLOT(autoPauseChanged(AutoPause::Reason)));
+}
+
+SessionRunner::~SessionRunner() {
+    disconnectProcess();
+}
+
+bool SessionRunner::start(Session *s, bool dryRun, bool useChanges) {
+    if (isRunning()) {
+        return false;
+    }
+
+    QStringList arguments;
+
+    currentSession = s;
+    currentSession->save();
+    arguments << currentSession->fileName();
+
+    isDryRun = dryRun;
+    isVerify = false;
+    usingChanges = !dryRun && useChanges && !currentSession->makeBackupsFlag() && QFile::exists(currentSession->changesFileName());
+    if (dryRun) {
+        arguments << "-d";
+    } else if (usingChanges) {
+        arguments << "-f" << currentSession->changesFileName();
+    }
+    launch(arguments);
+    return true;
+}
+
+bool SessionRunner::syncFiles(Session *s, const QString &fileList) {
+    if (isRunning()) {
+        return false;
+    }
+
+    QStringList arguments;
+
+    currentSession = s;
+    currentSession->save();
+    arguments << "-f" << fileList << currentSession->fileName();
+    isDryRun = isVerify = false;
+    usingChanges = true;
+    launch(arguments);
+    return true;
+}
+
+bool SessionRunner::verify(Session *s, int maxAge) {
+    if (isRunning()) {
+        return false;
+    }
+
+    QStringList arguments;
+
+    currentSession = s;
+    currentSession->save();
+    arguments << "-V";
+    if (maxAge > 0) {
+        arguments << "-a" << QString::number(maxAge);
+    }
+    arguments << currentSession->fileName();
+    isDryRun = usingChanges = false;
+    isVerify = true;
+    launch(arguments);
+    return true;
+}
+
+void SessionRunner::launch(const QStringList &arguments) {
+    if (!process) {
+        process = new RunnerProcess(this);
+        QStringList env(QProcess::systemEnvironment());
+        env.append(CARBON_GUI_PARENT"=true");
+        process->setEnvironment(env);
+        connect(process, SIGNAL(finished(int)), this, SLOT(processFinished(int)));
+        connect(process, SIGNAL(readyReadStandardOutput()), this, SLOT(readStdOut()));
+        connect(process, SIGNAL(readyReadStandardError()), this, SLOT(readStdErr()));
+    }
+
+    changeSet.clear();
+    runTiming.reset();
+    paused = autoPaused = pauseOverridden = false;
+    pausedMsecs = 0;
+    autoPause->start(currentSession->pauseOnBatteryFlag(), currentSession->pauseLoadLimit());
+    parser->reset();
+    logFile.close();
+    logFile.setFileName(currentSession->logFileName());
+    logFile.open(QIODevice::WriteOnly);
+    if (!recordFile.isEmpty()) {
+        fixture.startRecording(recordFile);
+    }
+    process->start(runner, arguments, QIODevice::ReadOnly);
+}
+
+// How long the runner has to clean up (remove its lock file, etc.) after SIGTERM, before it is killed
+static const int constTerminateTimeout = 5000;
+
+void SessionRunner::terminate() {
+    if (isRunning()) {
+        RunnerProcess *proc = process;
+
+        // Detach the process, so that its output and exit are ignored, and start() creates a new one
+        disconnect(proc, 0, this, 0);
+        process = 0;
+        connect(proc, SIGNAL(finished(int)), this, SLOT(processTerminated()));
+        connect(proc, SIGNAL(finished(int)), proc, SLOT(deleteLater()));
+        proc->terminateGroup(constTerminateTimeout);
+        autoPause->stop();
+        paused = false;
+        logFile.close();
+        fixture.stopRecording();
+    }
+}
+
+void SessionRunner::pause() {
+    setPaused(true, QString());
+}
+
+void SessionRunner::resume() {
+    // Don't pause again automatically, until the current reason has cleared
+    pauseOverridden = autoPaused || AutoPause::REASON_NONE != autoPause->reason();
+    setPaused(false, QString());
+}
+
+qint64 SessionRunner::pausedTime() const {
+    return pausedMsecs + (paused ? pauseClock.elapsed() : 0);
+}
+
+bool SessionRunner::isRunning() const {
+    return process && QProcess::NotRunning != process->state();
+}
+
+QString SessionRunner::errorString(int exitCode) {
+    switch (exitCode) {
+    case 101:
+        return tr("Usage error.");
+    case 102:
+        return tr("Could not read session file.");
+    case 103:
+        return tr("Destination folder does not exist, and could not be created.");
+    case 104:
+        return tr("Destination exists as a file.");
+    case 105:
+        return tr("Failed to mount destination folder.");
+    case 106:
+        return tr("Failed to unmount destination folder.");
+    case 107:
+        return tr("Mountpoint already exists.");
+    case 108:
+        return tr("Destination requires user@host");
+    case 109:
+        return tr("No source supplied.");
+    case 110:
+        return tr("No destination supplied.");
+    case 111:
+        return tr("Destination parent folder does not exist.");
+    case 112:
+        return tr("Source does not exist.");
+    case 113:
+        return tr("Session is already running.");
+    case 114:
+        return tr("Verification failed - files are missing, modified, or corrupt.");
+    case 115:
+        return tr("Only the increments of local backups can be verified.");
+    case 116:
+        return tr("The pre-sync command failed.");
+    case 117:
+        return tr("Could not take a snapshot of the source.");
+    case 1:
+        return tr("Syntax or usage error.");
+    case 2:
+        return tr("Protocol incompatibility.");
+    case 3:
+        return tr("Errors selecting input/output files/folders.");
+    case 4:
+        return tr("Requested action not supported: an attempt "
+                  "was made to manipulate 64-bit files on a "
+                  "platform that cannot support them; or an "
+                  "option was specified that is supported by "
+                  "the client and not by the server.");
+    case 5:
+        return tr("Error starting client-server protocol.");
+    case 6:
+        return tr("Daemon unable to append to log-file.");
+    case 10:
+        return tr("Error in socket I/O.");
+    case 11:
+        return tr("Error in file I/O.");
+    case 12:
+        return tr("Error in rsync protocol data stream.");
+    case 13:
+        return tr("Errors with program diagnostics.");
+    case 14:
+        return tr("Error in IPC code.");
+    case 20:
+        return tr("Received SIGUSR1 or SIGINT.");
+    case 21:
+        return tr("Some error returned by waitpid().");
+    case 22:
+        return tr("Error allocating core memory buffers.");
+    case 23:
+        return tr("Partial transfer due to error.");
+    case 24:
+        return tr("Partial transfer due to vanished source files.");
+    case 25:
+        return tr("The --max-delete limit stopped deletions.");
+    case 30:
+        return tr("Timeout in data send/receive.");
+    case 35:
+        return tr("Timeout waiting for daemon connection.");
+    default:
+        return tr("Unknown error code %1.").arg(exitCode);
+    }
+
+    return QString();
+}
+
+void SessionRunner::processFinished(int exitCode) {
+    autoPause->stop();
+    paused = false;
+    runTiming.finish();
+    if (!runTiming.isEmpty()) {
+        QTextStream(&logFile) << tr("Time taken: %1").arg(runTiming.toString()) << endl;
+        if (currentSession) {
+            // Same format as the runner's own history records
+            QFile history(currentSession->historyFileName());
+            if (history.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+                QTextStream(&history) << QDateTime::currentDateTime().toTime_t() << " timing exitCode=" << exitCode
+                                      << " dryRun=" << (isDryRun ? "true " : "false ") << runTiming.toHistory() << endl;
+            }
+        }
+    }
+    logFile.close();
+    fixture.stopRecording();
+    if (currentSession && !isVerify) {
+        // Keep the change set of a successful dry run, so that a following run may use it. Once used, it is stale.
+        if (isDryRun && 0 == exitCode && !changeSet.isEmpty() && !currentSession->makeBackupsFlag()) {
+            changeSet.save(currentSession->changesFileName());
+        } else if (isDryRun || 0 == exitCode) {
+            QFile::remove(currentSession->changesFileName());
+        }
+    }
+    emit finished(exitCode);
+}
+
+void SessionRunner::readStdOut() {
+    if (!process) {
+        return;
+    }
+
+    QByteArray all(process->readAllStandardOutput());
+    fixture.record(false, all);
+    parser->parse(all);
+
+    QString str(OutputParser::removePrefixes(all));
+    QTextStream(&logFile) << str;
+    emit output(str);
+}
+
+void SessionRunner::readStdErr() {
+    if (!process) {
+        return;
+    }
+
+    QByteArray all(process->readAllStandardError());
+    fixture.record(true, all);
+
+    QString str(OutputParser::removePrefixes(all));
+    QTextStream(&logFile) << str;
+    emit errorOutput(str);
+}
+
+void SessionRunner::addItem(const QString &itemised, qint64 size, const QString &path) {
+    if (changeSet.add(itemised, size, path)) {
+        emit item(itemised, size, path);
+    }
+}
+
+void SessionRunner::addPhase(const QString &name, qint64 msecs) {
+    runTiming.mark(name, msecs);
+    emit phase(name);
+}
+
+void SessionRunner::processTerminated() {
+    emit terminated();
+}
+
+void SessionRunner::autoPauseChanged(AutoPause::Reason reason) {
+    if (AutoPause::REASON_NONE == reason) {
+        pauseOverridden = false;
+        if (autoPaused) {
+            setPaused(false, QString());
+        }
+    } else if (!pauseOverridden && (!paused || autoPaused)) {
+        setPaused(true, AutoPause::toString(reason));
+        autoPaused = paused;
+    }
+}
+
+void SessionRunner::setPaused(bool p, const QString &reason) {
+    if (!isRunning()) {
+        return;
+    }
+
+    if (p != paused) {
+        if (p) {
+            process->pauseGroup();
+            pausedPhase = runTiming.current();
+            runTiming.mark(QLatin1String("paused"), -1);
+            pauseClock.start();
+        } else {
+            process->resumeGroup();
+            pausedMsecs += pauseClock.elapsed();
+            runTiming.mark(pausedPhase, -1);
+        }
+        paused = p;
+    }
+    autoPaused = false;
+    emit pauseChanged(paused, reason);
+}
+
+void SessionRunner::disconnectProcess() {
+    if (process) {
+        disconnect(process, SIGNAL(finished(int)), this, SLOT(processFinished(int)));
+        disconnect(process, SIGNAL(readyReadStandardOutput()), this, SLOT(readStdOut()));
+        disconnect(process, SIGNAL(readyReadStandardError()), this, SLOT(readStdErr()));
+        process->deleteLater();
+        process = 0;
+    }
+}
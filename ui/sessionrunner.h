@@ -0,0 +1,137 @@
+#ifndef __SESSION_RUNNER_H__
+#define __SESSION_RUNNER_H__
+
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+#include <QObject>
+#include <QFile>
+#include <QStringList>
+#include <QElapsedTimer>
+#include "autopause.h"
+#include "changeset.h"
+#include "fixture.h"
+#include "runtiming.h"
+
+class Session;
+class OutputParser;
+class RunnerProcess;
+
+// Runs carbon-runner for a single session, writes its log, and reports status via OutputParser.
+class SessionRunner : public QObject {
+    Q_OBJECT
+
+public:
+    SessionRunner(QObject *parent = 0);
+    virtual ~SessionRunner();
+
+    // If useChanges is set, and a previous dry run saved a change set, then only that is synchronised
+    bool start(Session *s, bool dryRun, bool useChanges = false);
+    // Only synchronise the paths (relative to the source) listed in fileList. Paths that no longer exist are deleted
+    // from the destination. Not used for backups.
+    bool syncFiles(Session *s, const QString &fileList);
+    // Check a backup's increments against the hashes catalogued when they were made. If maxAge > 0, files verified
+    // within that many days are only checked for changes, not read.
+    bool verify(Session *s, int maxAge = 0);
+    // Cancel the current run. Returns immediately - terminated() is emitted, instead of finished(), once the runner
+    // has exited. A new run may be started straight away.
+    void terminate();
+    // Stop, and continue, the runner's process group. If the session is set to pause automatically (on battery, or
+    // high load), then this also happens whilst it runs. Resuming manually overrides this, until the condition clears.
+    void pause();
+    void resume();
+    bool isPaused() const {
+        return paused;
+    }
+    // Time spent paused in the current run, in msecs
+    qint64 pausedTime() const;
+    bool isRunning() const;
+    // Defaults to the installed carbon-runner
+    void setRunner(const QString &r) {
+        runner = r;
+    }
+    // Record the runner's output, with timings, for replaying through OutputParser. Applies to the next start().
+    void setRecordFile(const QString &f) {
+        recordFile = f;
+    }
+    Session * session() const {
+        return currentSession;
+    }
+    const ChangeSet & changes() const {
+        return changeSet;
+    }
+    const RunTiming & timing() const {
+        return runTiming;
+    }
+
+    static QString errorString(int exitCode);
+
+Q_SIGNALS:
+    void status(const QString &str, bool isError);
+    void checking(int files);
+    void fileProgress(int percent);
+    void sessionProgress(int progress);
+    void item(const QString &itemised, qint64 size, const QString &path);
+    void phase(const QString &name);
+    void output(const QString &str);
+    void errorOutput(const QString &str);
+    void finished(int exitCode);
+    void terminated();
+    // reason is empty when paused manually
+    void pauseChanged(bool paused, const QString &reason);
+
+private Q_SLOTS:
+    void processFinished(int exitCode);
+    void processTerminated();
+    void readStdOut();
+    void readStdErr();
+    void addItem(const QString &itemised, qint64 size, const QString &path);
+    void addPhase(const QString &name, qint64 msecs);
+    void autoPauseChanged(AutoPause::Reason reason);
+
+private:
+    void launch(const QStringList &arguments);
+    void disconnectProcess();
+    void setPaused(bool p, const QString &reason);
+
+private:
+    QString runner;
+    QString recordFile;
+    Fixture fixture;
+    Session *currentSession;
+    bool isDryRun;
+    bool isVerify;
+    bool usingChanges;
+    ChangeSet changeSet;
+    RunTiming runTiming;
+    AutoPause *autoPause;
+    bool paused;
+    bool autoPaused;
+    bool pauseOverridden;
+    QString pausedPhase;
+    QElapsedTimer pauseClock;
+    qint64 pausedMsecs;
+    RunnerProcess *process;
+    OutputParser *parser;
+    QFile logFile;
+};
+
+#endif
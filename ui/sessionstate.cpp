@@ -0,0 +1,127 @@
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include "sessionstate.h"
+#include "config.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDir>
+#include <QStringList>
+
+// History records are appended, so the last run is within its last few records
+static const qint64 constHistoryTail = 16384;
+
+SessionState::SessionState()
+    : endTime(0)
+    , code(-1)
+    , isDryRun(false)
+    , duration(-1)
+    , transferred(-1)
+    , changed(-1) {
+}
+
+bool SessionState::read(const QString &fileName) {
+    QFile file(fileName);
+
+    *this = SessionState();
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    foreach (const QByteArray &line, file.readAll().split('\n')) {
+        set(line);
+    }
+    return !isNull();
+}
+
+// The last 'run' record in the history (or 'timing' record, as written by the GUI) has the same keys as a state
+// file - other than its time, which starts the line. Failing that, the log was last written when the run finished.
+bool SessionState::readLegacy(const QString &historyFile, const QString &logFile) {
+    QFile history(historyFile);
+
+    *this = SessionState();
+    if (history.open(QIODevice::ReadOnly)) {
+        if (history.size() > constHistoryTail) {
+            history.seek(history.size() - constHistoryTail);
+        }
+
+        QList<QByteArray> lines = history.readAll().split('\n');
+        for (int i = lines.count() - 1; i >= 0 && isNull(); --i) {
+            QList<QByteArray> parts = lines.at(i).split(' ');
+            if (parts.count() < 2 || ("run" != parts.at(1) && "timing" != parts.at(1))) {
+                continue;
+            }
+
+            for (int p = 2; p < parts.count(); ++p) {
+                set(parts.at(p));
+            }
+            endTime = parts.at(0).toUInt();
+        }
+    }
+
+    if (isNull()) {
+        QFileInfo log(logFile);
+        if (log.exists()) {
+            endTime = log.lastModified().toTime_t();
+        }
+    }
+    return !isNull();
+}
+
+void SessionState::set(const QByteArray &keyValue) {
+    int eq = keyValue.indexOf('=');
+    if (eq <= 0) {
+        return;
+    }
+
+    QByteArray key = keyValue.left(eq);
+    QByteArray value = keyValue.mid(eq + 1).trimmed();
+    if ("time" == key) {
+        endTime = value.toUInt();
+    } else if ("exitCode" == key) {
+        code = value.toInt();
+    } else if ("dryRun" == key) {
+        isDryRun = "true" == value;
+    } else if ("durationMs" == key || "total" == key) {
+        duration = value.toLongLong();
+    } else if ("bytes" == key) {
+        transferred = value.toLongLong();
+    } else if ("files" == key) {
+        changed = value.toLongLong();
+    }
+}
+
+QHash<QString, SessionState> SessionState::readDir(const QString &dir) {
+    static const QLatin1String constSuffix(CARBON_EXTENSION CARBON_STATE_EXTENSION);
+
+    QHash<QString, SessionState> states;
+    QDir d(dir);
+
+    foreach (const QString &f, d.entryList(QStringList() << QLatin1String("*" CARBON_EXTENSION CARBON_STATE_EXTENSION), QDir::Files)) {
+        SessionState state;
+        if (state.read(d.filePath(f))) {
+            states.insert(f.left(f.length() - constSuffix.size()), state);
+        }
+    }
+    return states;
+}
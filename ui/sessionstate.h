@@ -0,0 +1,80 @@
+#ifndef __SESSION_STATE_H__
+#define __SESSION_STATE_H__
+
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+
+// Outcome of a session's last run. Once each run finishes, the runner replaces <session>.sync.state with one
+// of these - as key=value lines (time, exitCode, dryRun, durationMs, bytes, files).
+class SessionState {
+public:
+    SessionState();
+
+    bool read(const QString &fileName);
+    // For sessions last run before the runner wrote state files. See readLegacy() in sessionstate.cpp.
+    bool readLegacy(const QString &historyFile, const QString &logFile);
+    // All of the states in dir, by session name. This is one directory listing, and only sessions that have been
+    // run have a file to read.
+    static QHash<QString, SessionState> readDir(const QString &dir);
+
+    bool isNull() const {
+        return 0 == endTime;
+    }
+    // When the run finished, as a time_t
+    uint time() const {
+        return endTime;
+    }
+    // < 0 if not known
+    int exitCode() const {
+        return code;
+    }
+    bool dryRun() const {
+        return isDryRun;
+    }
+    qint64 durationMs() const {
+        return duration;
+    }
+    // Bytes sent and received, and files created, updated, or deleted
+    qint64 bytes() const {
+        return transferred;
+    }
+    qint64 files() const {
+        return changed;
+    }
+
+private:
+    void set(const QByteArray &keyValue);
+
+private:
+    uint endTime;
+    int code;
+    bool isDryRun;
+    qint64 duration;
+    qint64 transferred;
+    qint64 changed;
+};
+
+#endif
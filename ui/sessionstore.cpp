@@ -0,0 +1,299 @@
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include "sessionstore.h"
+#include "sessionfile.h"
+#include "storage.h"
+#include "config.h"
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QFile>
+#include <QDir>
+#include <string.h>
+
+static const quint32 constMagic = 0x43425353; // "CBSS"
+static const quint32 constVersion = 1;
+
+static const char * constExtensions[SessionStore::FILE_NUM_TYPES] = {
+    CARBON_EXTENSION,
+    CARBON_EXTENSION CARBON_EXCLUDE_EXTENSION,
+    CARBON_EXTENSION CARBON_HISTORY_EXTENSION,
+    CARBON_EXTENSION CARBON_INFO_EXTENSION
+};
+
+static QString tr(const char *str) {
+    return QCoreApplication::translate("SessionStore", str);
+}
+
+// Names become file names, so must not reach outside of the folder
+static bool validName(const QString &name) {
+    return !name.isEmpty() && !name.startsWith(QLatin1Char('.')) && !name.contains(QLatin1Char('/'));
+}
+
+QString SessionStore::fileName(const QString &dir, const QString &name, FileType type) {
+    return dir + (dir.endsWith(QLatin1Char('/')) ? QString() : QString(QLatin1Char('/'))) + name +
+           QLatin1String(constExtensions[type]);
+}
+
+SessionStore::SessionStore(const QString &fileName)
+    : storeFile(fileName)
+    , transaction(false) {
+}
+
+bool SessionStore::load() {
+    entries.clear();
+    sourceIndex.clear();
+    error = QString();
+
+    QFile f(storeFile);
+    if (!f.exists()) {
+        return true; // New store
+    }
+    if (!f.open(QIODevice::ReadOnly)) {
+        error = tr("Failed to open %1").arg(storeFile);
+        return false;
+    }
+
+    QDataStream in(&f);
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 num = 0;
+
+    in.setVersion(QDataStream::Qt_5_0);
+    in >> magic >> version;
+    if (constMagic != magic) {
+        error = tr("%1 is not a session store").arg(storeFile);
+        return false;
+    }
+    if (version > constVersion) {
+        error = tr("%1 was written by a newer version").arg(storeFile);
+        return false;
+    }
+
+    in >> num;
+    for (quint32 i = 0; i < num && QDataStream::Ok == in.status(); ++i) {
+        Entry e;
+        quint32 types = 0;
+
+        in >> e.name >> e.source >> types;
+        // Newer versions are refused above, so more types than this version knows means the store is corrupt
+        if (types > FILE_NUM_TYPES) {
+            break;
+        }
+        for (quint32 t = 0; t < types && QDataStream::Ok == in.status(); ++t) {
+            in >> e.files[t];
+        }
+        if (!validName(e.name)) {
+            break;
+        }
+        entries.insert(e.name, e);
+        sourceIndex.insert(e.source, e.name);
+    }
+
+    if (QDataStream::Ok != in.status() || (quint32)entries.count() != num) {
+        entries.clear();
+        sourceIndex.clear();
+        error = tr("%1 is corrupt").arg(storeFile);
+        return false;
+    }
+    return true;
+}
+
+bool SessionStore::save() {
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+
+    out.setVersion(QDataStream::Qt_5_0);
+    out << constMagic << constVersion << (quint32)entries.count();
+
+    // Sorted, so that unchanged sessions give an unchanged file
+    foreach (const QString &name, names()) {
+        const Entry &e = *entries.constFind(name);
+
+        out << e.name << e.source << (quint32)FILE_NUM_TYPES;
+        for (int t = 0; t < FILE_NUM_TYPES; ++t) {
+            out << e.files[t];
+        }
+    }
+
+    if (!Storage::write(storeFile, data)) {
+        error = tr("Failed to write %1").arg(storeFile);
+        return false;
+    }
+    return true;
+}
+
+void SessionStore::begin() {
+    savedEntries = entries;
+    savedSourceIndex = sourceIndex;
+    transaction = true;
+}
+
+bool SessionStore::commit() {
+    if (!transaction) {
+        return save();
+    }
+
+    transaction = false;
+    if (!save()) {
+        // Keep memory matching what is on disk
+        entries = savedEntries;
+        sourceIndex = savedSourceIndex;
+        savedEntries.clear();
+        savedSourceIndex.clear();
+        return false;
+    }
+    savedEntries.clear();
+    savedSourceIndex.clear();
+    return true;
+}
+
+void SessionStore::rollback() {
+    if (transaction) {
+        entries = savedEntries;
+        sourceIndex = savedSourceIndex;
+        savedEntries.clear();
+        savedSourceIndex.clear();
+        transaction = false;
+    }
+}
+
+QStringList SessionStore::names() const {
+    QStringList list = entries.keys();
+    list.sort();
+    return list;
+}
+
+const SessionStore::Entry * SessionStore::find(const QString &name) const {
+    QHash<QString, Entry>::ConstIterator it = entries.constFind(name);
+    return entries.constEnd() == it ? 0 : &it.value();
+}
+
+QStringList SessionStore::findBySource(const QString &source) const {
+    return sourceIndex.values(source);
+}
+
+void SessionStore::insert(const Entry &entry) {
+    SessionFile cfg;
+    Entry e(entry);
+
+    remove(e.name);
+    cfg.read(e.files[FILE_SETTINGS]);
+    e.source = cfg.value(SessionFile::KEY_src);
+    entries.insert(e.name, e);
+    sourceIndex.insert(e.source, e.name);
+}
+
+bool SessionStore::remove(const QString &name) {
+    QHash<QString, Entry>::Iterator it = entries.find(name);
+
+    if (entries.end() == it) {
+        return false;
+    }
+    sourceIndex.remove(it.value().source, name);
+    entries.erase(it);
+    return true;
+}
+
+bool SessionStore::readSession(const QString &dir, const QString &name) {
+    Entry e;
+
+    if (!validName(name)) {
+        error = tr("Invalid session name: %1").arg(name);
+        return false;
+    }
+
+    e.name = name;
+    for (int t = 0; t < FILE_NUM_TYPES; ++t) {
+        QFile f(fileName(dir, name, (FileType)t));
+
+        if (!f.exists() && FILE_SETTINGS != t) {
+            continue;
+        }
+        if (!f.open(QIODevice::ReadOnly)) {
+            error = tr("Failed to read %1").arg(f.fileName());
+            return false;
+        }
+        e.files[t] = f.readAll();
+        if (e.files[t].isNull()) {
+            e.files[t] = QByteArray(""); // Empty, rather than missing
+        }
+    }
+
+    insert(e);
+    return true;
+}
+
+int SessionStore::readDir(const QString &dir) {
+    QStringList files = QDir(dir).entryList(QStringList() << "*" CARBON_EXTENSION, QDir::Files, QDir::Name);
+    int count = 0;
+
+    foreach (const QString &f, files) {
+        if (!readSession(dir, f.left(f.length() - (int)strlen(CARBON_EXTENSION)))) {
+            return -1;
+        }
+        ++count;
+    }
+    return count;
+}
+
+// The settings are written last, so that the session only appears once all of its files are there. A session without
+// an exclude file has any existing one removed - but the history, and last increment, are only ever replaced, as the
+// runner keeps those up to date.
+bool SessionStore::writeSession(const QString &dir, const QString &name) {
+    const Entry *e = find(name);
+
+    if (!e) {
+        error = tr("Unknown session: %1").arg(name);
+        return false;
+    }
+    if (!validName(name)) {
+        error = tr("Invalid session name: %1").arg(name);
+        return false;
+    }
+
+    for (int t = FILE_NUM_TYPES - 1; t >= 0; --t) {
+        QString file = fileName(dir, name, (FileType)t);
+
+        if (e->files[t].isNull()) {
+            if (FILE_EXCLUDE == t && QFile::exists(file) && !QFile::remove(file)) {
+                error = tr("Failed to remove %1").arg(file);
+                return false;
+            }
+        } else if (!Storage::write(file, e->files[t])) {
+            error = tr("Failed to write %1").arg(file);
+            return false;
+        }
+    }
+    return true;
+}
+
+int SessionStore::writeDir(const QString &dir, const QStringList &only) {
+    QStringList list = only.isEmpty() ? names() : only;
+
+    foreach (const QString &name, list) {
+        if (!writeSession(dir, name)) {
+            return -1;
+        }
+    }
+    return list.count();
+}
@@ -0,0 +1,96 @@
+#ifndef __SESSION_STORE_H__
+#define __SESSION_STORE_H__
+
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QHash>
+#include <QMultiHash>
+
+// A single file holding any number of sessions - their settings, exclude patterns, and run history - so that they can
+// be deployed, and updated, as one. The runner only reads the .sync layout, so sessions are read into a store from a
+// folder of those files, and written back out to one. Files are kept byte for byte, so both directions are lossless.
+//
+// Changes are made in memory, and saved with save() - or, for bulk updates, between begin() and commit(), with
+// rollback() to discard them. save() replaces the whole store with Storage::write(), so it is never partially updated.
+class SessionStore {
+public:
+    enum FileType {
+        FILE_SETTINGS,  // .sync
+        FILE_EXCLUDE,   // .sync.exclude
+        FILE_HISTORY,   // .sync.history
+        FILE_INFO,      // .sync.info - the last backup increment, the base of the next
+
+        FILE_NUM_TYPES
+    };
+
+    struct Entry {
+        QString name;
+        QString source;
+        QByteArray files[FILE_NUM_TYPES]; // Null if the session does not have that file
+    };
+
+    static QString fileName(const QString &dir, const QString &name, FileType type);
+
+    SessionStore(const QString &fileName);
+
+    bool load();
+    bool save();
+    const QString & errorString() const {
+        return error;
+    }
+
+    void begin();
+    bool commit();
+    void rollback();
+    bool inTransaction() const {
+        return transaction;
+    }
+
+    int count() const {
+        return entries.count();
+    }
+    QStringList names() const;
+    const Entry * find(const QString &name) const;
+    QStringList findBySource(const QString &source) const;
+    void insert(const Entry &entry);
+    bool remove(const QString &name);
+
+    bool readSession(const QString &dir, const QString &name);
+    int readDir(const QString &dir);
+    bool writeSession(const QString &dir, const QString &name);
+    int writeDir(const QString &dir, const QStringList &only = QStringList());
+
+private:
+    QString storeFile;
+    QString error;
+    QHash<QString, Entry> entries;
+    QMultiHash<QString, QString> sourceIndex;
+    bool transaction;
+    QHash<QString, Entry> savedEntries;
+    QMultiHash<QString, QString> savedSourceIndex;
+};
+
+#endif
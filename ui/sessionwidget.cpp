@@ -21,6 +21,7 @@
 
 #include "sessionwidget.h"
 #include "sessiondialog.h"
+#include "sessionmodel.h"
 #include "session.h"
 #include "runnerdialog.h"
 #include "config.h"
@@ -34,6 +35,11 @@
 #include <QSettings>
 #include <QHeaderView>
 #include <QFileInfo>
+#include <QFormLayout>
+#include <QLabel>
+#include <QLineEdit>
+#include <QSet>
+#include <QSortFilterProxyModel>
 
 #define CFG_GROUP     "SessionWidget/"
 #define CFG_COL_SIZES CFG_GROUP "List"
@@ -66,105 +72,99 @@ private:
     QTextEdit *edit;
 };
 
-enum EColumns {
-    COL_NAME,
-    COL_TYPE,
-    COL_LAST_RUN,
-
-    NUM_COLS
-};
-
-static QString typeStr(bool backup) {
-    return backup ? QObject::tr("Backup") : QObject::tr("Synchronisation");
-}
-
-class SessionWidgetItem : public QTreeWidgetItem {
+// Asks for the name, source, and destination of copies of the selected sessions - as templates, where %n, %s, and %d
+// are replaced by the name, source, and destination of the session being copied.
+class CloneDialog : public Dialog {
 public:
-    SessionWidgetItem(QTreeWidget *parent, const QString &s)
-        : QTreeWidgetItem(parent)
-        , session(new Session(s)) {
-        update();
-    }
-
-    SessionWidgetItem(QTreeWidget *parent, Session *s)
-        : QTreeWidgetItem(parent)
-        , session(s) {
-        update();
-        session->save();
-    }
-
-    void update() {
-        setText(COL_NAME, session->name());
-        setText(COL_TYPE, typeStr(session->makeBackupsFlag()));
-        setText(COL_LAST_RUN, session->last().isEmpty() ? QObject::tr("Never") : session->last());
-        setToolTip();
-    }
 
-    void setLastRun(const QString &str) {
-        setText(COL_LAST_RUN, str);
-        setToolTip();
+    CloneDialog(QWidget *parent, int count)
+        : Dialog(parent) {
+        QWidget *w = new QWidget(this);
+        QFormLayout *layout = new QFormLayout(w);
+        QLabel *label = new QLabel(QObject::tr("%1, %2, and %3 are replaced by the name, source, and destination of the "
+                                               "session being copied.")
+                                   .arg(QLatin1String("%n"), QLatin1String("%s"), QLatin1String("%d")), w);
+
+        label->setWordWrap(true);
+        nameEdit = new QLineEdit(QLatin1String("%n copy"), w);
+        srcEdit = new QLineEdit(QLatin1String("%s"), w);
+        destEdit = new QLineEdit(QLatin1String("%d"), w);
+        layout->addRow(label);
+        layout->addRow(QObject::tr("Name:"), nameEdit);
+        layout->addRow(QObject::tr("Source:"), srcEdit);
+        layout->addRow(QObject::tr("Destination:"), destEdit);
+        setMainWidget(w);
+        setButtons(Ok | Cancel);
+        setCaption(1 == count ? QObject::tr("Clone Session") : QObject::tr("Clone %1 Sessions").arg(count));
     }
 
-    operator bool() {
-        return session;
+    QString name(const Session &s) const {
+        return expand(nameEdit->text(), s).trimmed();
     }
-
-    Session & sessionData() {
-        return *session;
+    QString src(const Session &s) const {
+        return Utils::convertDirFromDisplay(expand(srcEdit->text(), s));
     }
-
-    void remove() {
-        if (session->erase()) {
-            delete session;
-            delete this;
-        }
+    QString dest(const Session &s) const {
+        return Utils::convertDirFromDisplay(expand(destEdit->text(), s));
     }
 
 private:
-    void setToolTip() {
-        QString tip(QObject::tr("<p><h3>%1</h3></p><p>"
-                                "<table>"
-                                "<tr><td>Source:</td><td>%2</td></tr>"
-                                "<tr><td>Destination:</td><td>%3</td></tr>")
-                    .arg(text(COL_NAME))
-                    .arg(session->source())
-                    .arg(session->destination()));
-
-        for (int i = 0; i < NUM_COLS; ++i) {
-            QTreeWidgetItem::setToolTip(i, tip);
+
+    static QString expand(const QString &tmpl, const Session &s) {
+        QString str;
+        for (int i = 0; i < tmpl.length(); ++i) {
+            if (QLatin1Char('%') == tmpl.at(i) && i + 1 < tmpl.length()) {
+                QChar c = tmpl.at(i + 1);
+                if (QLatin1Char('n') == c || QLatin1Char('s') == c || QLatin1Char('d') == c) {
+                    str += QLatin1Char('n') == c
+                           ? s.name()
+                           : Utils::convertDirForDisplay(QLatin1Char('s') == c ? s.source() : s.destination());
+                    ++i;
+                    continue;
+                }
+            }
+            str += tmpl.at(i);
         }
+        return str;
     }
 
-private:
-    Session *session;
+    QLineEdit *nameEdit;
+    QLineEdit *srcEdit;
+    QLineEdit *destEdit;
 };
 
-static QStringList toNames(QList<QTreeWidgetItem *> &items) {
-    QStringList                             names;
-    QList<QTreeWidgetItem *>::ConstIterator it(items.constBegin());
-    QList<QTreeWidgetItem *>::ConstIterator end(items.constEnd());
-
-    for (; it != end; ++it)
-        names.append(((SessionWidgetItem *)(*it))->sessionData().name());
+static QStringList toNames(const QList<Session *> &list) {
+    QStringList names;
 
+    foreach (Session *s, list) {
+        names.append(s->name());
+    }
     return names;
 }
 
 SessionWidget::SessionWidget(QWidget *parent)
     : QWidget(parent)
     , defSession(tr("New Session"), true)
+    , model(0L)
+    , proxy(0L)
     , sessionDialog(0L)
     , runnerDialog(0L)
     , logViewer(0L)
-    , menu(0L) {
+    , menu(0L)
+    , batch(0L)
+    , busy(false) {
     setupUi(this);
     setupWidgets();
     QTimer::singleShot(0, this, SLOT(loadSessions()));
 }
 
 SessionWidget::~SessionWidget() {
+    if (batch) {
+        batch->wait();
+    }
+
     QStringList list;
-    for (int i = 0; i < NUM_COLS; ++i) {
+    for (int i = 0; i < SessionModel::NUM_COLS; ++i) {
         list << QString::number(sessions->header()->sectionSize(i));
     }
 
@@ -173,42 +173,49 @@ SessionWidget::~SessionWidget() {
 }
 
 bool SessionWidget::exists(const QString &name) const {
-    return 0 != sessions->findItems(name, Qt::MatchExactly).count();
+    return model->exists(name);
 }
 
 bool SessionWidget::srcExists(const QString &path) const {
-    for (int i = 0; i < sessions->topLevelItemCount(); ++i) {
-        SessionWidgetItem *item = static_cast<SessionWidgetItem *>(sessions->topLevelItem(i));
-        if (item->sessionData().source() == path) {
-            return true;
-        }
-    }
-    return false;
+    return model->srcExists(path);
 }
 
 void SessionWidget::setBackground(const QIcon &icon) {
     sessions->setBackground(icon);
 }
 
+// The filter only looks at the sessions' settings, and so does not need their history. Sorting is by the model's
+// SortRole, so that durations and sizes sort by value.
 void SessionWidget::setupWidgets() {
+    model = new SessionModel(this);
+    proxy = new QSortFilterProxyModel(this);
+    proxy->setSourceModel(model);
+    proxy->setFilterRole(SessionModel::FilterRole);
+    proxy->setFilterKeyColumn(SessionModel::COL_NAME);
+    proxy->setFilterCaseSensitivity(Qt::CaseInsensitive);
+    proxy->setSortRole(SessionModel::SortRole);
+    sessions->setModel(proxy);
+    sessions->sortByColumn(SessionModel::COL_NAME, Qt::AscendingOrder);
+
     controlSyncButtons();
     controlButtons();
-    connect(sessions, SIGNAL(itemSelectionChanged()), SLOT(controlButtons()));
+    connect(sessions->selectionModel(), SIGNAL(selectionChanged(QItemSelection, QItemSelection)), SLOT(controlButtons()));
+    connect(filter, SIGNAL(textChanged(QString)), proxy, SLOT(setFilterFixedString(QString)));
 }
 
 void SessionWidget::newSession() {
+    if (busy) {
+        return;
+    }
+
     createSessionDialog();
 
     if (sessionDialog->run(defSession, false)) {
         Session *session = new Session;
 
         sessionDialog->get(*session);
-
-        SessionWidgetItem *item = new SessionWidgetItem(sessions, session);
-
-        if (!*item) {
-            delete item;
-        }
+        session->save();
+        model->add(QList<Session *>() << session);
 
         controlButtons();
         controlSyncButtons();
@@ -216,49 +223,176 @@ void SessionWidget::newSession() {
 }
 
 void SessionWidget::editSession() {
-    QList<QTreeWidgetItem *> sessionList(sessions->selectedItems());
+    QList<Session *> sessionList(selectedSessions());
+
+    if (busy) {
+        return;
+    }
 
     if (1 == sessionList.count()) {
         createSessionDialog();
 
-        SessionWidgetItem *session = (SessionWidgetItem *)sessionList.at(0);
+        Session *session = sessionList.at(0);
 
-        if (sessionDialog->run(session->sessionData(), true)) {
-            sessionDialog->get(session->sessionData());
-            session->sessionData().save();
-            session->update();
+        if (sessionDialog->run(*session, true)) {
+            sessionDialog->get(*session);
+            session->save();
+            model->update(QSet<Session *>() << session);
         }
+    } else if (sessionList.count() > 1) {
+        editSessions(sessionList);
     }
 }
 
+// The dialog edits a copy of the first session. Only the settings that were changed are then applied to all of the
+// sessions, and they are saved together on the worker thread.
+void SessionWidget::editSessions(const QList<Session *> &list) {
+    createSessionDialog();
+
+    Session &first = *list.at(0);
+    Session *original = first.clone(first.name(), first.source(), first.destination());
+    Session *edited = first.clone(first.name(), first.source(), first.destination());
+
+    if (sessionDialog->run(*edited, true, list.count())) {
+        sessionDialog->get(*edited);
+        foreach (Session *s, list) {
+            s->apply(*original, *edited);
+        }
+        startBatch(SessionBatch::OP_SAVE, list);
+    }
+
+    delete original;
+    delete edited;
+}
+
+void SessionWidget::cloneSession() {
+    QList<Session *> sessionList(selectedSessions());
+
+    if (busy || sessionList.isEmpty()) {
+        return;
+    }
+
+    CloneDialog dlg(this, sessionList.count());
+    if (QDialog::Accepted != dlg.exec()) {
+        return;
+    }
+
+    // Names, and sources, of the clones so far - existing sessions are checked with the model
+    QSet<QString> names;
+    QSet<QString> sources;
+    QStringList errors;
+    QList<Session *> list;
+    foreach (Session *orig, sessionList) {
+        Session &s = *orig;
+        QString name = dlg.name(s);
+        QString src = dlg.src(s);
+        QString dest = dlg.dest(s);
+
+        if (name.isEmpty() || name.startsWith(QLatin1Char('.')) || name.contains(QLatin1Char('/'))) {
+            errors.append(tr("%1: Invalid name").arg(s.name()));
+        } else if (names.contains(name) || model->exists(name)) {
+            errors.append(tr("%1: A session named %2 already exists").arg(s.name()).arg(name));
+        } else if (src.isEmpty() || dest.isEmpty()) {
+            errors.append(tr("%1: No source, or destination").arg(s.name()));
+        } else if (sources.contains(src) || model->srcExists(src)) {
+            errors.append(tr("%1: A session with source %2 already exists").arg(s.name()).arg(src));
+        } else if (dest.startsWith(src)) {
+            errors.append(tr("%1: Destination must not be located within source").arg(s.name()));
+        } else {
+            names.insert(name);
+            sources.insert(src);
+            list.append(s.clone(name, src, dest));
+        }
+    }
+
+    if (!errors.isEmpty()) {
+        qDeleteAll(list);
+        MessageBox::errorList(this, tr("The sessions could not be cloned:"), errors);
+        return;
+    }
+
+    clones = list;
+    startBatch(SessionBatch::OP_SAVE, list);
+}
+
 void SessionWidget::removeSession() {
-    QList<QTreeWidgetItem *> sessionList(sessions->selectedItems());
-    QStringList              names(toNames(sessionList));
+    QList<Session *> sessionList(selectedSessions());
+    QStringList      names(toNames(sessionList));
+
+    if (busy) {
+        return;
+    }
 
     if ((sessionList.count() == 1 && QMessageBox::Yes == MessageBox::warningYesNo(this, tr("Delete <b>%1</b>?").arg(*(names.begin())))) ||
             (sessionList.count() > 1 && QMessageBox::Yes == MessageBox::warningYesNoList(this, tr("Delete the following sessions?"), names))) {
-        QList<QTreeWidgetItem *>::Iterator it(sessionList.begin());
-        QList<QTreeWidgetItem *>::Iterator end(sessionList.end());
+        startBatch(SessionBatch::OP_ERASE, sessionList);
+    }
+}
+
+// The list is disabled whilst the worker thread has the sessions
+void SessionWidget::startBatch(SessionBatch::Operation op, const QList<Session *> &list) {
+    if (!batch) {
+        batch = new SessionBatch(this);
+        connect(batch, SIGNAL(finished()), SLOT(batchFinished()));
+    }
+
+    busy = true;
+    setEnabled(false);
+    emit itemsSelected(false);
+    emit singleItemSelected(false);
+    emit haveSessions(false);
+    batch->process(op, list);
+}
+
+// Updates the list once for the whole batch
+void SessionWidget::batchFinished() {
+    QSet<Session *> done = batch->sessions().toSet();
+    QSet<Session *> failed = batch->failures().toSet();
+    QStringList failedNames;
 
-        for (; it != end; ++it) {
-            SessionWidgetItem *item = (SessionWidgetItem *)(*it);
-            item->remove();
+    foreach (Session *s, batch->failures()) {
+        failedNames.append(s->name());
+    }
+
+    if (SessionBatch::OP_ERASE == batch->operation()) {
+        model->remove(done - failed);
+    } else if (!clones.isEmpty()) {
+        QList<Session *> added;
+        foreach (Session *s, clones) {
+            if (failed.contains(s)) {
+                s->erase(); // Remove anything that was written
+                delete s;
+            } else {
+                added.append(s);
+            }
         }
+        clones.clear();
+        model->add(added);
+    } else {
+        model->update(done);
+    }
 
-        controlButtons();
-        controlSyncButtons();
+    busy = false;
+    setEnabled(true);
+    controlButtons();
+    controlSyncButtons();
+
+    if (!failedNames.isEmpty()) {
+        MessageBox::errorList(this, SessionBatch::OP_ERASE == batch->operation()
+                              ? tr("The following sessions could not be deleted:")
+                              : tr("The following sessions could not be saved:"), failedNames);
     }
 }
 
 void SessionWidget::showSessionLog() {
-    QList<QTreeWidgetItem *> sessionList(sessions->selectedItems());
+    QList<Session *> sessionList(selectedSessions());
 
     if (1 == sessionList.count()) {
         if (!logViewer) {
             logViewer = new CLogViewer(this);
         }
 
-        logViewer->show(((SessionWidgetItem *)(*(sessionList.begin())))->sessionData());
+        logViewer->show(*sessionList.at(0));
     }
 }
 
@@ -278,12 +412,11 @@ void SessionWidget::restoreSession(bool on) {
 }
 
 void SessionWidget::controlButtons() {
-    QList<QTreeWidgetItem *> sessionList(sessions->selectedItems());
+    QList<Session *> sessionList(selectedSessions());
 
     emit singleItemSelected(1 == sessionList.count());
     emit itemsSelected(sessionList.count() > 0);
-    emit haveLog(1 == sessionList.count() &&
-                 !((SessionWidgetItem *)(*(sessionList.begin())))->sessionData().last().isEmpty());
+    emit haveLog(1 == sessionList.count() && QFile::exists(sessionList.at(0)->logFileName()));
 }
 
 void SessionWidget::setAsDefaults() {
@@ -292,35 +425,38 @@ void SessionWidget::setAsDefaults() {
 }
 
 void SessionWidget::controlSyncButtons() {
-    emit haveSessions(sessions->topLevelItemCount() > 0);
+    emit haveSessions(model->count() > 0);
 }
 
 void SessionWidget::loadSessions() {
-    QFileInfoList sessionList = QDir(Utils::dataDir(QString(), true)).entryInfoList(QStringList() << "*" CARBON_EXTENSION, QDir::NoDotAndDotDot | QDir::Files);
-    int pos;
-    int srlen(strlen(CARBON_RUNNER));
+    QString dir = Utils::dataDir(QString(), true);
+    QFileInfoList sessionList = QDir(dir).entryInfoList(QStringList() << "*" CARBON_EXTENSION, QDir::NoDotAndDotDot | QDir::Files);
+    QHash<QString, SessionState> states = SessionState::readDir(dir);
+    QList<Session *> loaded;
 
     foreach (const QFileInfo &session, sessionList) {
-        SessionWidgetItem *item = new SessionWidgetItem(sessions, session.absoluteFilePath());
-
-        if (!*item) {
-            delete item;
+        Session *s = new Session(session.absoluteFilePath());
+        QHash<QString, SessionState>::ConstIterator it = states.constFind(s->name());
+        if (it != states.constEnd()) {
+            s->setLastRun(it.value());
+        } else {
+            s->updateLastRun();
         }
+        loaded.append(s);
     }
 
+    model->set(loaded);
     controlSyncButtons();
 
     QStringList list;
     QSettings cfg;
     list = cfg.value(CFG_COL_SIZES, list).toStringList();
 
-    if (NUM_COLS == list.count()) {
-        for (int i = 0; i < NUM_COLS; ++i) {
+    if (SessionModel::NUM_COLS == list.count()) {
+        for (int i = 0; i < SessionModel::NUM_COLS; ++i) {
             sessions->header()->resizeSection(i, list[i].toInt());
         }
     }
-
-    sessions->sortItems(0, Qt::AscendingOrder);
 }
 
 void SessionWidget::contextMenuEvent(QContextMenuEvent *e) {
@@ -330,10 +466,10 @@ void SessionWidget::contextMenuEvent(QContextMenuEvent *e) {
 }
 
 void SessionWidget::doSessions(bool dryRun) {
-    QList<QTreeWidgetItem *> sessionList(selectedSessions());
+    QList<Session *> sessionDataList(selectedSessions(true));
 
-    if (sessionList.count()) {
-        QStringList names(toNames(sessionList));
+    if (!busy && sessionDataList.count()) {
+        QStringList names(toNames(sessionDataList));
 
         if ((1 == names.count() &&
                 QMessageBox::Yes == MessageBox::questionYesNo(this, dryRun
@@ -344,25 +480,30 @@ void SessionWidget::doSessions(bool dryRun) {
                          ? tr("Perform a dry run of the following sessions?")
                          : tr("Synchronise the following sessions?"),
                          names))) {
-            QList<Session *> sessionDataList;
-
-            foreach (QTreeWidgetItem *i, sessionList) {
-                sessionDataList.append(&(((SessionWidgetItem *)(i))->sessionData()));
-            }
-
             if (sessionDataList.count()) {
                 if (!runnerDialog) {
                     runnerDialog = new RunnerDialog(this);
                 }
 
                 runnerDialog->go(sessionDataList, dryRun);
+                if (dryRun && runnerDialog->changesAccepted()) {
+                    // Only sessions with a saved change set have anything to synchronise
+                    QList<Session *> changed;
+                    foreach (Session *s, sessionDataList) {
+                        if (QFile::exists(s->changesFileName())) {
+                            changed.append(s);
+                        }
+                    }
+                    if (!changed.isEmpty()) {
+                        runnerDialog->go(changed, false, true);
+                    }
+                }
 
-                for (int i = 0; i < sessions->topLevelItemCount(); ++i) {
-                    SessionWidgetItem *item = (SessionWidgetItem *)(sessions->topLevelItem(i));
-
-                    item->sessionData().updateLast();
-                    item->setLastRun(item->sessionData().last());
+                // Only the sessions that were run can have changed
+                foreach (Session *s, sessionDataList) {
+                    s->updateLastRun();
                 }
+                model->update(sessionDataList.toSet());
             }
         }
     }
@@ -375,13 +516,20 @@ void SessionWidget::createSessionDialog() {
     }
 }
 
-QList<QTreeWidgetItem *> SessionWidget::selectedSessions() {
-    QList<QTreeWidgetItem *> sessionList(sessions->selectedItems());
+// Sessions hidden by the filter are never selected. If none are selected, and allIfNone is set, then all of those
+// that are shown are returned.
+QList<Session *> SessionWidget::selectedSessions(bool allIfNone) const {
+    QList<Session *> list;
+    QModelIndexList rows = sessions->selectionModel()->selectedRows();
 
-    if (0 == sessionList.count()) {
-        for (int i = 0; i < sessions->topLevelItemCount(); ++i) {
-            sessionList.append(sessions->topLevelItem(i));
+    if (rows.isEmpty() && allIfNone) {
+        for (int i = 0; i < proxy->rowCount(); ++i) {
+            rows.append(proxy->index(i, 0));
         }
     }
-    return sessionList;
+
+    foreach (const QModelIndex &idx, rows) {
+        list.append(model->session(proxy->mapToSource(idx)));
+    }
+    return list;
 }
@@ -24,9 +24,12 @@
 
 #include "ui_sessionwidget.h"
 #include "session.h"
+#include "sessionbatch.h"
 
 class QContextMenuEvent;
 class QMenu;
+class QSortFilterProxyModel;
+class SessionModel;
 class SessionDialog;
 class RunnerDialog;
 class CLogViewer;
@@ -59,6 +62,7 @@ Q_SIGNALS:
 public Q_SLOTS:
     void newSession();
     void editSession();
+    void cloneSession();
     void removeSession();
     void showSessionLog();
     void dryRunSession();
@@ -68,20 +72,30 @@ public Q_SLOTS:
     void setAsDefaults();
     void loadSessions();
 
+private Q_SLOTS:
+    void batchFinished();
+
 private:
     void contextMenuEvent(QContextMenuEvent *e);
     void controlSyncButtons();
     void setupWidgets();
     void doSessions(bool dryRun);
     void createSessionDialog();
-    QList<QTreeWidgetItem *> selectedSessions();
+    void editSessions(const QList<Session *> &list);
+    void startBatch(SessionBatch::Operation op, const QList<Session *> &list);
+    QList<Session *> selectedSessions(bool allIfNone = false) const;
 
 private:
     Session       defSession;
+    SessionModel  *model;
+    QSortFilterProxyModel *proxy;
     SessionDialog *sessionDialog;
     RunnerDialog  *runnerDialog;
     CLogViewer    *logViewer;
     QMenu         *menu;
+    SessionBatch  *batch;
+    bool          busy;
+    QList<Session *> clones;
 };
 
 #endif
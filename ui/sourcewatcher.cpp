@@ -0,0 +1,206 @@
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include "sourcewatcher.h"
+#include <QSocketNotifier>
+#include <QTimer>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+// Changes are passed on once none have happened for constSettleTime msecs, or constMaxDelay msecs after the first
+// one - whichever is sooner - so that a burst of writes becomes one batch, without a busy tree delaying it forever.
+static const int constSettleTime = 1000;
+static const int constMaxDelay = 5000;
+
+static const uint32_t constEvents = IN_CREATE | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                    IN_DELETE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+static QString join(const QString &dir, const QString &name) {
+    return dir.isEmpty() ? name : dir + QLatin1Char('/') + name;
+}
+
+SourceWatcher::SourceWatcher(QObject *parent)
+    : QObject(parent)
+    , fd(-1)
+    , notifier(0)
+    , timer(new QTimer(this))
+    , rescan(false) {
+    timer->setSingleShot(true);
+    connect(timer, SIGNAL(timeout()), SLOT(settled()));
+}
+
+SourceWatcher::~SourceWatcher() {
+    stop();
+}
+
+bool SourceWatcher::start(const QString &folder) {
+    stop();
+    errorStr = QString();
+    root = QDir(folder).absolutePath();
+    fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        errorStr = tr("Could not watch for changes (%1)").arg(QString::fromLocal8Bit(::strerror(errno)));
+        return false;
+    }
+    notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(notifier, SIGNAL(activated(int)), SLOT(readEvents()));
+    addWatches(QString(), false);
+    if (watches.isEmpty()) {
+        errorStr = tr("Could not watch %1 (%2)").arg(root).arg(QString::fromLocal8Bit(::strerror(errno)));
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void SourceWatcher::stop() {
+    timer->stop();
+    delete notifier;
+    notifier = 0;
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    watches.clear();
+    changes.clear();
+    rescan = false;
+}
+
+QStringList SourceWatcher::takeChanges() {
+    QStringList list = changes.toList();
+    changes.clear();
+    rescan = false;
+    timer->stop();
+    return list;
+}
+
+void SourceWatcher::readEvents() {
+    // Large enough for many events per read(). Each event is followed by its (padded) name.
+    char buffer[64 * 1024] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+    for (;;) {
+        ssize_t len = ::read(fd, buffer, sizeof(buffer));
+        if (len <= 0) {
+            break;
+        }
+
+        for (char *ptr = buffer; ptr < buffer + len; ) {
+            const struct inotify_event *event = (const struct inotify_event *)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                rescan = true;
+                continue;
+            }
+
+            QHash<int, QString>::ConstIterator it = watches.constFind(event->wd);
+            if (it == watches.constEnd()) {
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                watches.remove(event->wd);
+                continue;
+            }
+            if (0 == event->len) {
+                continue; // Events on the watched folder itself are reported by its parent
+            }
+
+            QString path = join(it.value(), QFile::decodeName(event->name));
+            addChange(path);
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    // Files may have been created before the folder could be watched, so list its contents too
+                    addWatches(path, true);
+                } else if (event->mask & IN_MOVED_FROM) {
+                    removeWatches(path);
+                }
+            }
+        }
+    }
+
+    if (hasChanges()) {
+        if (!timer->isActive()) {
+            firstChange.start();
+        }
+        timer->start(qMax(0, qMin(constSettleTime, constMaxDelay - (int)firstChange.elapsed())));
+    }
+}
+
+void SourceWatcher::settled() {
+    if (hasChanges()) {
+        emit changed();
+    }
+}
+
+void SourceWatcher::addWatches(const QString &path, bool added) {
+    QString full = path.isEmpty() ? root : join(root, path);
+    int wd = ::inotify_add_watch(fd, QFile::encodeName(full).constData(), constEvents);
+
+    if (wd < 0) {
+        // Most likely the folder has gone again, or fs.inotify.max_user_watches was reached. Either way, changes
+        // within it are only found by a full synchronisation.
+        if (ENOENT != errno && ENOTDIR != errno) {
+            rescan = true;
+        }
+        return;
+    }
+    watches.insert(wd, path);
+
+    QDir dir(full);
+    foreach (const QFileInfo &info, dir.entryInfoList(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot)) {
+        QString child = join(path, info.fileName());
+        if (added) {
+            addChange(child);
+        }
+        if (info.isDir() && !info.isSymLink()) {
+            addWatches(child, added);
+        }
+    }
+}
+
+void SourceWatcher::removeWatches(const QString &path) {
+    QString prefix = path + QLatin1Char('/');
+    QHash<int, QString>::Iterator it = watches.begin();
+
+    while (it != watches.end()) {
+        if (it.value() == path || it.value().startsWith(prefix)) {
+            ::inotify_rm_watch(fd, it.key());
+            it = watches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void SourceWatcher::addChange(const QString &path) {
+    // --files-from is newline separated
+    if (path.contains(QLatin1Char('\n'))) {
+        rescan = true;
+    } else {
+        changes.insert(path);
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef __SOURCE_WATCHER_H__
+#define __SOURCE_WATCHER_H__
+
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QSet>
+#include <QHash>
+#include <QElapsedTimer>
+
+class QSocketNotifier;
+class QTimer;
+
+// Watches a local folder tree, with inotify, and collects the paths (relative to the folder) that are created,
+// modified, moved, or deleted. Once changes have settled, changed() is emitted, and they may be taken as a batch to
+// pass to rsync's --files-from. If events are lost (the kernel's queue overflowed, or there are too many folders
+// to watch) the batch is marked as needing a full synchronisation instead.
+class SourceWatcher : public QObject {
+    Q_OBJECT
+
+public:
+    SourceWatcher(QObject *parent = 0);
+    virtual ~SourceWatcher();
+
+    bool start(const QString &folder);
+    void stop();
+    const QString & error() const {
+        return errorStr;
+    }
+    bool hasChanges() const {
+        return rescan || !changes.isEmpty();
+    }
+    // Changes could not all be tracked, so the next batch must be a full synchronisation
+    bool needsFullSync() const {
+        return rescan;
+    }
+    // Force the next batch to be a full synchronisation - e.g. if syncing a batch failed
+    void setNeedsFullSync() {
+        rescan = true;
+    }
+    // Take the current batch, and start a new one
+    QStringList takeChanges();
+
+Q_SIGNALS:
+    void changed();
+
+private Q_SLOTS:
+    void readEvents();
+    void settled();
+
+private:
+    void addWatches(const QString &path, bool added);
+    void removeWatches(const QString &path);
+    void addChange(const QString &path);
+
+private:
+    int fd;
+    QString root;
+    QString errorStr;
+    QSocketNotifier *notifier;
+    QTimer *timer;
+    QElapsedTimer firstChange; // When the oldest change in the batch happened
+    QHash<int, QString> watches; // Watch descriptor to relative folder path
+    QSet<QString> changes;
+    bool rescan;
+};
+
+#endif
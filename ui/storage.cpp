@@ -0,0 +1,94 @@
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include "storage.h"
+#include <QFile>
+#include <QAtomicInt>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static QAtomicInt tmpCounter;
+
+static bool writeAll(int fd, const char *data, qint64 len) {
+    while (len > 0) {
+        ssize_t written = ::write(fd, data, len);
+        if (written < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        len -= written;
+    }
+    return true;
+}
+
+static void syncDir(const QByteArray &fileName) {
+    int slash = fileName.lastIndexOf('/');
+    QByteArray dir = slash > 0 ? fileName.left(slash) : slash == 0 ? QByteArray("/") : QByteArray(".");
+    int fd = ::open(dir.constData(), O_RDONLY | O_DIRECTORY);
+
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+bool Storage::write(const QString &fileName, const QByteArray &data) {
+    QByteArray dest = QFile::encodeName(fileName);
+    QByteArray tmp;
+    int fd = -1;
+
+    // Not mkstemp(), as that ignores the umask. O_EXCL, and the pid and counter, keep the name unique.
+    for (int i = 0; i < 16 && fd < 0; ++i) {
+        tmp = dest + ".tmp." + QByteArray::number(::getpid()) + '.' + QByteArray::number(tmpCounter.fetchAndAddRelaxed(1));
+        fd = ::open(tmp.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+        if (fd < 0 && EEXIST != errno) {
+            return false;
+        }
+    }
+
+    if (fd < 0) {
+        return false;
+    }
+
+    // Keep the permissions of the file being replaced
+    struct stat info;
+    if (0 == ::stat(dest.constData(), &info)) {
+        ::fchmod(fd, info.st_mode & 07777);
+    }
+
+    bool ok = writeAll(fd, data.constData(), data.size()) && 0 == ::fsync(fd);
+
+    ok = 0 == ::close(fd) && ok;
+    if (!ok || 0 != ::rename(tmp.constData(), dest.constData())) {
+        ::unlink(tmp.constData());
+        return false;
+    }
+
+    syncDir(dest);
+    return true;
+}
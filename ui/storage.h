@@ -0,0 +1,37 @@
+#ifndef __STORAGE_H__
+#define __STORAGE_H__
+
+/*
+  Carbon (C) Craig Drummond, 2013 craig.p.drummond@gmail.com
+
+  ----
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; see the file COPYING.  If not, write to
+  the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+
+#include <QString>
+#include <QByteArray>
+
+// Crash-safe replacement of the files that make up a session.
+//
+// write() writes the data to a new file in the same folder, flushes it to disk, renames it over fileName, and then
+// flushes the folder - so that after a crash, or power loss, fileName holds either its old or its new contents.
+namespace Storage {
+    extern bool write(const QString &fileName, const QByteArray &data);
+}
+
+#endif
@@ -55,24 +55,32 @@ static QPixmap createBgndPixmap(const QIcon &icon) {
     return pix;
 }
 
-TreeWidget::TreeWidget(QWidget *p)
-    : QTreeWidget(p) {
-    setAlternatingRowColors(false);
-    setRootIsDecorated(false);
-    setSortingEnabled(true);
-    setAllColumnsShowFocus(true);
-    setIndentation(0);
-    setItemDelegate(new BasicItemDelegate(this));
+static void setupView(QTreeView *view) {
+    view->setAlternatingRowColors(false);
+    view->setRootIsDecorated(false);
+    view->setSortingEnabled(true);
+    view->setAllColumnsShowFocus(true);
+    view->setIndentation(0);
+    view->setItemDelegate(new BasicItemDelegate(view));
 }
 
-void TreeWidget::setBackground(const QIcon &icon) {
-    QPalette pal = parentWidget()->palette();
+static QPixmap setupBackground(QAbstractItemView *view, const QIcon &icon) {
+    QPalette pal = view->parentWidget()->palette();
     if (!icon.isNull()) {
         pal.setColor(QPalette::Base, Qt::transparent);
     }
-    setPalette(pal);
-    viewport()->setPalette(pal);
-    bgnd = createBgndPixmap(icon);
+    view->setPalette(pal);
+    view->viewport()->setPalette(pal);
+    return createBgndPixmap(icon);
+}
+
+TreeWidget::TreeWidget(QWidget *p)
+    : QTreeWidget(p) {
+    setupView(this);
+}
+
+void TreeWidget::setBackground(const QIcon &icon) {
+    bgnd = setupBackground(this, icon);
 }
 
 void TreeWidget::paintEvent(QPaintEvent *e) {
@@ -82,3 +90,22 @@ void TreeWidget::paintEvent(QPaintEvent *e) {
     }
     QTreeWidget::paintEvent(e);
 }
+
+TreeView::TreeView(QWidget *p)
+    : QTreeView(p) {
+    setupView(this);
+    // All rows are a single line of text, so the view need not ask each row for its size
+    setUniformRowHeights(true);
+}
+
+void TreeView::setBackground(const QIcon &icon) {
+    bgnd = setupBackground(this, icon);
+}
+
+void TreeView::paintEvent(QPaintEvent *e) {
+    if (!bgnd.isNull()) {
+        QPainter p(viewport());
+        p.fillRect(viewport()->rect(), bgnd);
+    }
+    QTreeView::paintEvent(e);
+}
@@ -23,6 +23,7 @@
 */
 
 #include <QTreeWidget>
+#include <QTreeView>
 #include <QPixmap>
 
 class QIcon;
@@ -39,4 +40,17 @@ private:
     QPixmap bgnd;
 };
 
+// As TreeWidget, for views of a model
+class TreeView : public QTreeView {
+public:
+    TreeView(QWidget *p = 0);
+    virtual ~TreeView() { }
+
+    void setBackground(const QIcon &icon);
+    void paintEvent(QPaintEvent *e);
+
+private:
+    QPixmap bgnd;
+};
+
 #endif // TREEWIDGET_H